@@ -3345,6 +3345,66 @@ static void test_deleted_key(void)
     setup_main_key();
 }
 
+static void test_many_subkeys(void)
+{
+    char name[32];
+    DWORD count;
+    HKEY hkey, subkey;
+    LONG res;
+    int i;
+
+    res = RegCreateKeyA( hkey_main, "many_subkeys", &hkey );
+    ok( !res, "RegCreateKeyA failed: %d\n", res );
+
+    /* create them in reverse order, so that every key is inserted in front */
+    for (i = 599; i >= 0; i--)
+    {
+        sprintf( name, "Subkey%03d", i );
+        res = RegCreateKeyA( hkey, name, &subkey );
+        ok( !res, "RegCreateKeyA %s failed: %d\n", name, res );
+        RegCloseKey( subkey );
+    }
+
+    res = RegQueryInfoKeyA( hkey, NULL, NULL, NULL, &count, NULL, NULL, NULL, NULL, NULL, NULL, NULL );
+    ok( !res, "RegQueryInfoKeyA failed: %d\n", res );
+    ok( count == 600, "got %u subkeys\n", count );
+
+    for (i = 0; i < 600; i++)
+    {
+        sprintf( name, "SUBKEY%03d", i );
+        res = RegOpenKeyA( hkey, name, &subkey );
+        ok( !res, "RegOpenKeyA %s failed: %d\n", name, res );
+        RegCloseKey( subkey );
+    }
+
+    res = RegEnumKeyA( hkey, 0, name, sizeof(name) );
+    ok( !res, "RegEnumKeyA failed: %d\n", res );
+    ok( !strcmp( name, "Subkey000" ), "got %s\n", name );
+    res = RegEnumKeyA( hkey, 599, name, sizeof(name) );
+    ok( !res, "RegEnumKeyA failed: %d\n", res );
+    ok( !strcmp( name, "Subkey599" ), "got %s\n", name );
+
+    for (i = 0; i < 600; i += 2)
+    {
+        sprintf( name, "subkey%03d", i );
+        res = RegDeleteKeyA( hkey, name );
+        ok( !res, "RegDeleteKeyA %s failed: %d\n", name, res );
+    }
+
+    for (i = 0; i < 600; i++)
+    {
+        sprintf( name, "Subkey%03d", i );
+        res = RegOpenKeyA( hkey, name, &subkey );
+        if (i % 2)
+            ok( !res, "RegOpenKeyA %s failed: %d\n", name, res );
+        else
+            ok( res == ERROR_FILE_NOT_FOUND, "RegOpenKeyA %s returned %d\n", name, res );
+        if (!res) RegCloseKey( subkey );
+    }
+
+    delete_key( hkey );
+}
+
 static void test_delete_value(void)
 {
     LONG res;
@@ -3566,6 +3626,7 @@ START_TEST(registry)
     test_reg_delete_tree();
     test_rw_order();
     test_deleted_key();
+    test_many_subkeys();
     test_delete_value();
     test_delete_key_value();
     test_RegOpenCurrentUser();
@@ -4964,6 +4964,103 @@ static void test_GetFileAttributesExW(void)
     ok(GetLastError() == ERROR_FILE_NOT_FOUND, "Expected error ERROR_FILE_NOT_FOUND, got %u\n", GetLastError());
 }
 
+static void test_case_insensitive_lookup(void)
+{
+    char temp_path[MAX_PATH], dir[MAX_PATH + 16], path[MAX_PATH + 48];
+    FILETIME ft;
+    DWORD attrs;
+    HANDLE file;
+    BOOL ret;
+    int i;
+
+    GetTempPathA( MAX_PATH, temp_path );
+    sprintf( dir, "%sCaseLookup", temp_path );
+    ret = CreateDirectoryA( dir, NULL );
+    ok( ret, "CreateDirectory failed, gle=%d\n", GetLastError() );
+
+    for (i = 0; i < 40; i++)
+    {
+        sprintf( path, "%s\\MixedCaseName%02d.Txt", dir, i );
+        file = CreateFileA( path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL );
+        ok( file != INVALID_HANDLE_VALUE, "CreateFile %s failed, gle=%d\n", path, GetLastError() );
+        CloseHandle( file );
+    }
+
+    for (i = 0; i < 40; i++)
+    {
+        sprintf( path, "%s\\MIXEDCASENAME%02d.TXT", dir, i );
+        attrs = GetFileAttributesA( path );
+        ok( attrs != INVALID_FILE_ATTRIBUTES, "GetFileAttributes %s failed, gle=%d\n", path, GetLastError() );
+        sprintf( path, "%s\\mixedcasename%02d.txt", dir, i );
+        attrs = GetFileAttributesA( path );
+        ok( attrs != INVALID_FILE_ATTRIBUTES, "GetFileAttributes %s failed, gle=%d\n", path, GetLastError() );
+    }
+
+    sprintf( path, "%s\\mixedcasename40.txt", dir );
+    SetLastError( 0xdeadbeef );
+    attrs = GetFileAttributesA( path );
+    ok( attrs == INVALID_FILE_ATTRIBUTES, "GetFileAttributes %s succeeded\n", path );
+    ok( GetLastError() == ERROR_FILE_NOT_FOUND, "got error %u\n", GetLastError() );
+
+    /* changes to the directory must be seen right away */
+    sprintf( path, "%s\\MixedCaseName40.Txt", dir );
+    file = CreateFileA( path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile %s failed, gle=%d\n", path, GetLastError() );
+    CloseHandle( file );
+    sprintf( path, "%s\\MIXEDCASENAME40.TXT", dir );
+    attrs = GetFileAttributesA( path );
+    ok( attrs != INVALID_FILE_ATTRIBUTES, "GetFileAttributes %s failed, gle=%d\n", path, GetLastError() );
+
+    /* setting the modification time back must not hide new files */
+    file = CreateFileA( dir, FILE_READ_ATTRIBUTES | FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                        NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile %s failed, gle=%d\n", dir, GetLastError() );
+    ret = GetFileTime( file, NULL, NULL, &ft );
+    ok( ret, "GetFileTime failed, gle=%d\n", GetLastError() );
+    sprintf( path, "%s\\MixedCaseName41.Txt", dir );
+    attrs = GetFileAttributesA( path );
+    ok( attrs == INVALID_FILE_ATTRIBUTES, "GetFileAttributes %s succeeded\n", path );
+    CloseHandle( CreateFileA( path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL ));
+    ret = SetFileTime( file, NULL, NULL, &ft );
+    ok( ret, "SetFileTime failed, gle=%d\n", GetLastError() );
+    CloseHandle( file );
+    sprintf( path, "%s\\MIXEDCASENAME41.TXT", dir );
+    attrs = GetFileAttributesA( path );
+    ok( attrs != INVALID_FILE_ATTRIBUTES, "GetFileAttributes %s failed, gle=%d\n", path, GetLastError() );
+
+    sprintf( path, "%s\\MixedCaseName00.Txt", dir );
+    ret = DeleteFileA( path );
+    ok( ret, "DeleteFile %s failed, gle=%d\n", path, GetLastError() );
+    sprintf( path, "%s\\MIXEDCASENAME00.TXT", dir );
+    SetLastError( 0xdeadbeef );
+    attrs = GetFileAttributesA( path );
+    ok( attrs == INVALID_FILE_ATTRIBUTES, "GetFileAttributes %s succeeded\n", path );
+    ok( GetLastError() == ERROR_FILE_NOT_FOUND, "got error %u\n", GetLastError() );
+
+    for (i = 1; i <= 41; i++)
+    {
+        sprintf( path, "%s\\mixedcasename%02d.txt", dir, i );
+        ret = DeleteFileA( path );
+        ok( ret, "DeleteFile %s failed, gle=%d\n", path, GetLastError() );
+    }
+    ret = RemoveDirectoryA( dir );
+    ok( ret, "RemoveDirectory failed, gle=%d\n", GetLastError() );
+
+    /* the system directory hasn't changed recently, so its names may be indexed */
+    GetSystemDirectoryA( temp_path, MAX_PATH );
+    sprintf( path, "%s\\KERNEL32.DLL", temp_path );
+    attrs = GetFileAttributesA( path );
+    ok( attrs != INVALID_FILE_ATTRIBUTES, "GetFileAttributes %s failed, gle=%d\n", path, GetLastError() );
+    sprintf( path, "%s\\KeRnEl32.dLl", temp_path );
+    attrs = GetFileAttributesA( path );
+    ok( attrs != INVALID_FILE_ATTRIBUTES, "GetFileAttributes %s failed, gle=%d\n", path, GetLastError() );
+    sprintf( path, "%s\\KeRnEl32_DoEsNoTeXiSt.dLl", temp_path );
+    SetLastError( 0xdeadbeef );
+    attrs = GetFileAttributesA( path );
+    ok( attrs == INVALID_FILE_ATTRIBUTES, "GetFileAttributes %s succeeded\n", path );
+    ok( GetLastError() == ERROR_FILE_NOT_FOUND, "got error %u\n", GetLastError() );
+}
+
 START_TEST(file)
 {
     InitFunctionPointers();
@@ -5022,4 +5119,5 @@ START_TEST(file)
     test_GetFinalPathNameByHandleW();
     test_SetFileInformationByHandle();
     test_GetFileAttributesExW();
+    test_case_insensitive_lookup();
 }
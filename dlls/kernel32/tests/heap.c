@@ -39,6 +39,7 @@
 #define HEAP_VALIDATE_PARAMS  0x40000000
 
 static BOOL (WINAPI *pHeapQueryInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T, PSIZE_T);
+static BOOL (WINAPI *pHeapSetInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T);
 static BOOL (WINAPI *pGetPhysicallyInstalledSystemMemory)(ULONGLONG *);
 static ULONG (WINAPI *pRtlGetNtGlobalFlags)(void);
 
@@ -892,6 +893,162 @@ static void test_HeapQueryInformation(void)
     ok(info == 0 || info == 1 || info == 2, "expected 0, 1 or 2, got %u\n", info);
 }
 
+static void test_lfh(void)
+{
+    static const SIZE_T sizes[] = { 1, 8, 16, 24, 100, 200, 500, 1000, 2000 };
+    BYTE *ptrs[64 * ARRAY_SIZE(sizes)];
+    HANDLE heap;
+    ULONG info;
+    SIZE_T size;
+    BOOL ret;
+    int i, j, pass;
+
+    pHeapSetInformation = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"), "HeapSetInformation");
+    if (!pHeapSetInformation || !pHeapQueryInformation)
+    {
+        win_skip("HeapSetInformation is not available\n");
+        return;
+    }
+
+    heap = HeapCreate( 0, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed\n" );
+
+    info = 2;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( ret, "HeapSetInformation error %u\n", GetLastError() );
+
+    info = 0xdeadbeef;
+    ret = pHeapQueryInformation( heap, HeapCompatibilityInformation, &info, sizeof(info), NULL );
+    ok( ret, "HeapQueryInformation error %u\n", GetLastError() );
+    ok( info == 2, "expected 2, got %u\n", info );
+
+    /* run twice, so that the second pass reuses the blocks freed by the first one */
+    for (pass = 0; pass < 2; pass++)
+    {
+        for (i = 0; i < ARRAY_SIZE(ptrs); i++)
+        {
+            size = sizes[i % ARRAY_SIZE(sizes)];
+            ptrs[i] = HeapAlloc( heap, (i & 1) ? HEAP_ZERO_MEMORY : 0, size );
+            ok( ptrs[i] != NULL, "HeapAlloc %lu failed\n", size );
+            ok( HeapSize( heap, 0, ptrs[i] ) == size, "got size %lu, expected %lu\n",
+                HeapSize( heap, 0, ptrs[i] ), size );
+            if (i & 1)
+            {
+                for (j = 0; j < size; j++) if (ptrs[i][j]) break;
+                ok( j == size, "memory not zeroed at %d/%lu\n", j, size );
+            }
+            memset( ptrs[i], i, size );
+        }
+        for (i = 0; i < ARRAY_SIZE(ptrs); i++)
+        {
+            size = sizes[i % ARRAY_SIZE(sizes)];
+            for (j = 0; j < size; j++) if (ptrs[i][j] != (BYTE)i) break;
+            ok( j == size, "block %d overwritten at %d/%lu\n", i, j, size );
+        }
+        ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+
+        for (i = 0; i < ARRAY_SIZE(ptrs); i += 2)
+        {
+            ret = HeapFree( heap, 0, ptrs[i] );
+            ok( ret, "HeapFree failed\n" );
+        }
+        ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+
+        for (i = 1; i < ARRAY_SIZE(ptrs); i += 2)
+        {
+            size = sizes[i % ARRAY_SIZE(sizes)];
+            ptrs[i] = HeapReAlloc( heap, 0, ptrs[i], size + 10 );
+            ok( ptrs[i] != NULL, "HeapReAlloc failed\n" );
+            for (j = 0; j < size; j++) if (ptrs[i][j] != (BYTE)i) break;
+            ok( j == size, "block %d not preserved at %d/%lu\n", i, j, size );
+            ret = HeapFree( heap, 0, ptrs[i] );
+            ok( ret, "HeapFree failed\n" );
+        }
+        ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+    }
+
+    HeapDestroy( heap );
+}
+
+/* runs in a child process, since Windows may terminate the process on heap corruption */
+static void test_child_lfh_invalid_free(void)
+{
+    HANDLE heap, heap2;
+    BYTE *ptrs[3];
+    ULONG info;
+    BOOL ret;
+
+    pHeapSetInformation = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"), "HeapSetInformation");
+
+    heap = HeapCreate( 0, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed\n" );
+    heap2 = HeapCreate( 0, 0, 0 );
+    ok( heap2 != NULL, "HeapCreate failed\n" );
+    info = 2;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( ret, "HeapSetInformation error %u\n", GetLastError() );
+    ret = pHeapSetInformation( heap2, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( ret, "HeapSetInformation error %u\n", GetLastError() );
+
+    /* freeing into the wrong heap must not cache the block */
+    ptrs[0] = HeapAlloc( heap, 0, 24 );
+    ok( ptrs[0] != NULL, "HeapAlloc failed\n" );
+    SetLastError( 0xdeadbeef );
+    ret = HeapFree( heap2, 0, ptrs[0] );
+    ok( !ret, "HeapFree succeeded\n" );
+    ok( GetLastError() == ERROR_INVALID_PARAMETER, "wrong error %u\n", GetLastError() );
+    ptrs[1] = HeapAlloc( heap2, 0, 24 );
+    ok( ptrs[1] != NULL && ptrs[1] != ptrs[0], "got %p for %p\n", ptrs[1], ptrs[0] );
+    ok( HeapValidate( heap2, 0, NULL ), "HeapValidate failed\n" );
+    ret = HeapFree( heap2, 0, ptrs[1] );
+    ok( ret, "HeapFree failed\n" );
+
+    /* double free of a cached block */
+    ret = HeapFree( heap, 0, ptrs[0] );
+    ok( ret, "HeapFree failed\n" );
+    SetLastError( 0xdeadbeef );
+    ret = HeapFree( heap, 0, ptrs[0] );
+    ok( !ret, "HeapFree succeeded\n" );
+    ok( GetLastError() == ERROR_INVALID_PARAMETER, "wrong error %u\n", GetLastError() );
+    ptrs[1] = HeapAlloc( heap, 0, 24 );
+    ptrs[2] = HeapAlloc( heap, 0, 24 );
+    ok( ptrs[1] != NULL && ptrs[2] != NULL, "HeapAlloc failed\n" );
+    ok( ptrs[1] != ptrs[2], "block returned twice\n" );
+    ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+
+    HeapDestroy( heap2 );
+    HeapDestroy( heap );
+}
+
+static void test_lfh_invalid_free( const char *argv0 )
+{
+    STARTUPINFOA startup;
+    PROCESS_INFORMATION info;
+    char buffer[MAX_PATH + 32];
+    DWORD exit_code = 1;
+    BOOL ret;
+
+    if (!GetProcAddress( GetModuleHandleA("kernel32.dll"), "HeapSetInformation" ))
+    {
+        win_skip( "HeapSetInformation is not available\n" );
+        return;
+    }
+
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    sprintf( buffer, "%s heap.c lfh_invalid_free", argv0 );
+    ret = CreateProcessA( NULL, buffer, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info );
+    ok( ret, "failed to create child process error %u\n", GetLastError() );
+    if (!ret) return;
+
+    ok( !WaitForSingleObject( info.hProcess, 30000 ), "child process wait failed\n" );
+    GetExitCodeProcess( info.hProcess, &exit_code );
+    ok( !exit_code || broken(exit_code == 0xc0000374),  /* STATUS_HEAP_CORRUPTION */
+        "child process exited with %#x\n", exit_code );
+    CloseHandle( info.hThread );
+    CloseHandle( info.hProcess );
+}
+
 static void test_heap_checks( DWORD flags )
 {
     BYTE old, *p, *p2;
@@ -1226,7 +1383,8 @@ START_TEST(heap)
     argc = winetest_get_mainargs( &argv );
     if (argc >= 3)
     {
-        test_child_heap( argv[2] );
+        if (!strcmp( argv[2], "lfh_invalid_free" )) test_child_lfh_invalid_free();
+        else test_child_heap( argv[2] );
         return;
     }
 
@@ -1245,6 +1403,8 @@ START_TEST(heap)
     test_sized_HeapReAlloc((1 << 20), 1);
 
     test_HeapQueryInformation();
+    test_lfh();
+    test_lfh_invalid_free( argv[0] );
     test_GetPhysicallyInstalledSystemMemory();
 
     if (pRtlGetNtGlobalFlags)
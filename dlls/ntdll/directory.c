@@ -180,6 +180,7 @@ struct dir_data_names
     const WCHAR *long_name;          /* long file name in Unicode */
     const WCHAR *short_name;         /* short file name in Unicode */
     const char  *unix_name;          /* Unix file name in host encoding */
+    unsigned int long_len;           /* length of the long file name in chars */
 };
 
 struct dir_data
@@ -199,6 +200,27 @@ static const unsigned int dir_data_names_initial_size  = 64;
 static struct dir_data **dir_data_cache;
 static unsigned int dir_data_cache_size;
 
+/* index of the names of a directory, for case-insensitive lookups in find_file_in_dir */
+struct dir_lookup_cache
+{
+    struct file_identity  id;         /* directory file identity */
+    time_t                ctime;      /* directory status change time when the index was built */
+    long                  ctime_nsec; /* nanoseconds part of the status change time */
+    struct dir_data      *data;       /* directory file names */
+    unsigned int          hash_size;  /* size of the hash tables, a power of 2 */
+    unsigned int         *long_hash;  /* first entry of each long name hash chain */
+    unsigned int         *short_hash; /* first entry of each short name hash chain */
+    unsigned int         *long_next;  /* next entry in the long name hash chain */
+    unsigned int         *short_next; /* next entry in the short name hash chain */
+};
+
+#define DIR_LOOKUP_CACHE_SIZE 16
+#define DIR_LOOKUP_END        (~0u)
+
+static struct dir_lookup_cache *dir_lookup_cache[DIR_LOOKUP_CACHE_SIZE];
+static unsigned int dir_lookup_cache_pos;  /* next entry to replace */
+static unsigned int dir_lookup_hits, dir_lookup_misses, dir_lookup_builds;
+
 static BOOL show_dot_files;
 static RTL_RUN_ONCE init_once = RTL_RUN_ONCE_INIT;
 
@@ -363,6 +385,7 @@ static BOOL add_dir_data_names( struct dir_data *data, const WCHAR *long_name,
 
     if (!(names[data->count].long_name = add_dir_data_nameW( data, long_name ))) return FALSE;
     if (!(names[data->count].unix_name = add_dir_data_nameA( data, unix_name ))) return FALSE;
+    names[data->count].long_len = strlenW( long_name );
     data->count++;
     return TRUE;
 }
@@ -1514,7 +1537,7 @@ static NTSTATUS get_dir_data_entry( struct dir_data *dir_data, void *info_ptr, I
     if (start + dir_size > max_length) return STATUS_MORE_ENTRIES;
 
     max_length -= start + dir_size;
-    name_len = strlenW( names->long_name ) * sizeof(WCHAR);
+    name_len = names->long_len * sizeof(WCHAR);
     /* if this is not the first entry, fail; the first entry is always returned (but truncated) */
     if (*last_info && name_len > max_length) return STATUS_MORE_ENTRIES;
 
@@ -1812,8 +1835,8 @@ static int name_compare( const void *a, const void *b )
 {
     const struct dir_data_names *file_a = (const struct dir_data_names *)a;
     const struct dir_data_names *file_b = (const struct dir_data_names *)b;
-    int ret = RtlCompareUnicodeStrings( file_a->long_name, strlenW(file_a->long_name),
-                                        file_b->long_name, strlenW(file_b->long_name), TRUE );
+    int ret = RtlCompareUnicodeStrings( file_a->long_name, file_a->long_len,
+                                        file_b->long_name, file_b->long_len, TRUE );
     if (!ret) ret = strcmpW( file_a->long_name, file_b->long_name );
     return ret;
 }
@@ -2024,6 +2047,225 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
 }
 
 
+/* case-insensitive hash of a file name, consistent with memicmpW */
+static unsigned int hash_dir_lookup_name( const WCHAR *name, int length )
+{
+    unsigned int hash = 0;
+
+    while (length--) hash = hash * 65599 + tolowerW( *name++ );
+    return hash;
+}
+
+/* free a directory lookup index */
+static void free_dir_lookup_cache( struct dir_lookup_cache *cache )
+{
+    if (!cache) return;
+    free_dir_data( cache->data );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->long_hash );
+    RtlFreeHeap( GetProcessHeap(), 0, cache );
+}
+
+
+/* nanoseconds part of the status change time of a file, if available */
+static long get_ctime_nsec( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_CTIM
+    return st->st_ctim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_CTIMESPEC)
+    return st->st_ctimespec.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+
+/***********************************************************************
+ *           build_dir_lookup_cache
+ *
+ * Read a directory and build the hash tables of its long and short names.
+ * The chains are kept in readdir order so that lookups find the same entry as a scan.
+ */
+static struct dir_lookup_cache *build_dir_lookup_cache( const char *unix_name, const struct stat *st )
+{
+    struct dir_lookup_cache *cache;
+    struct dirent *de;
+    unsigned int i, h;
+    DIR *dir;
+
+    if (!(cache = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cache) ))) return NULL;
+    cache->id.dev = st->st_dev;
+    cache->id.ino = st->st_ino;
+    cache->ctime  = st->st_ctime;
+    cache->ctime_nsec = get_ctime_nsec( st );
+    if (!(cache->data = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cache->data) )))
+        goto failed;
+
+    if (!(dir = opendir( unix_name ))) goto failed;
+    while ((de = readdir( dir )))
+    {
+        if (!append_entry( cache->data, de->d_name, NULL, NULL ))
+        {
+            closedir( dir );
+            goto failed;
+        }
+    }
+    closedir( dir );
+
+    for (cache->hash_size = 16; cache->hash_size < cache->data->count; cache->hash_size *= 2) ;
+    if (!(cache->long_hash = RtlAllocateHeap( GetProcessHeap(), 0,
+                                              (cache->hash_size + cache->data->count) * 2 *
+                                              sizeof(*cache->long_hash) )))
+        goto failed;
+    cache->short_hash = cache->long_hash + cache->hash_size;
+    cache->long_next  = cache->short_hash + cache->hash_size;
+    cache->short_next = cache->long_next + cache->data->count;
+    for (i = 0; i < cache->hash_size; i++) cache->long_hash[i] = cache->short_hash[i] = DIR_LOOKUP_END;
+
+    /* insert at the head of the chains in reverse order to keep the readdir order */
+    for (i = cache->data->count; i--; )
+    {
+        const struct dir_data_names *names = &cache->data->names[i];
+
+        h = hash_dir_lookup_name( names->long_name, names->long_len ) & (cache->hash_size - 1);
+        cache->long_next[i] = cache->long_hash[h];
+        cache->long_hash[h] = i;
+        cache->short_next[i] = DIR_LOOKUP_END;
+        if (!names->short_name[0]) continue;
+        h = hash_dir_lookup_name( names->short_name, strlenW( names->short_name )) & (cache->hash_size - 1);
+        cache->short_next[i] = cache->short_hash[h];
+        cache->short_hash[h] = i;
+    }
+
+    dir_lookup_builds++;
+    TRACE( "%s: %u entries, %u hits %u misses %u builds\n", debugstr_a(unix_name),
+           cache->data->count, dir_lookup_hits, dir_lookup_misses, dir_lookup_builds );
+    return cache;
+
+failed:
+    free_dir_lookup_cache( cache );
+    return NULL;
+}
+
+
+/***********************************************************************
+ *           is_dir_lookup_cache_allowed
+ *
+ * Check if the names of a directory can be indexed. On network and FUSE
+ * file systems the timestamps may be coarse, or set by a host with a skewed
+ * clock, so it can't be trusted to detect changes.
+ */
+static BOOL is_dir_lookup_cache_allowed( const char *unix_name )
+{
+#if defined(__linux__) && defined(HAVE_SYS_STATFS_H)
+    struct statfs stfs;
+
+    if (statfs( unix_name, &stfs ) == -1) return FALSE;
+    switch ((unsigned int)stfs.f_type)
+    {
+    case 0x6969:      /* NFS_SUPER_MAGIC */
+    case 0x517b:      /* SMB_SUPER_MAGIC */
+    case 0xff534d42:  /* CIFS_MAGIC_NUMBER */
+    case 0xfe534d42:  /* SMB2_MAGIC_NUMBER */
+    case 0x65735546:  /* FUSE_SUPER_MAGIC */
+    case 0x01021997:  /* V9FS_MAGIC */
+    case 0x00c36400:  /* CEPH_SUPER_MAGIC */
+    case 0x5346414f:  /* AFS_SUPER_MAGIC */
+    case 0x73757245:  /* CODA_SUPER_MAGIC */
+        return FALSE;
+    }
+    return TRUE;
+#elif defined(MNT_LOCAL) && (defined(HAVE_SYS_MOUNT_H) || defined(HAVE_SYS_STATFS_H))
+    struct statfs stfs;
+
+    if (statfs( unix_name, &stfs ) == -1) return FALSE;
+    return (stfs.f_flags & MNT_LOCAL) != 0;
+#else
+    return TRUE;
+#endif
+}
+
+
+/***********************************************************************
+ *           get_dir_lookup_cache
+ *
+ * Get the lookup index for a directory, building it if necessary.
+ * The index is validated with the directory ctime, which unlike the mtime
+ * can't be set back by applications. Directories changed in the last couple
+ * of seconds are not indexed, since file system timestamps can be coarser
+ * than a change, and neither are directories on network or FUSE file systems.
+ * dir_section must be held by caller.
+ */
+static struct dir_lookup_cache *get_dir_lookup_cache( const char *unix_name )
+{
+    struct dir_lookup_cache *cache;
+    struct stat st;
+    unsigned int i;
+
+    if (stat( unix_name, &st ) == -1) return NULL;
+
+    for (i = 0; i < DIR_LOOKUP_CACHE_SIZE; i++)
+    {
+        if (!(cache = dir_lookup_cache[i])) continue;
+        if (cache->id.dev != st.st_dev || cache->id.ino != st.st_ino) continue;
+        if (cache->ctime == st.st_ctime && cache->ctime_nsec == get_ctime_nsec( &st )) return cache;
+        free_dir_lookup_cache( cache );
+        dir_lookup_cache[i] = NULL;
+        break;
+    }
+
+    if (st.st_ctime >= time(NULL) - 1) return NULL;
+    if (!is_dir_lookup_cache_allowed( unix_name )) return NULL;
+    if (!(cache = build_dir_lookup_cache( unix_name, &st ))) return NULL;
+
+    if (i == DIR_LOOKUP_CACHE_SIZE)
+    {
+        i = dir_lookup_cache_pos;
+        dir_lookup_cache_pos = (dir_lookup_cache_pos + 1) % DIR_LOOKUP_CACHE_SIZE;
+        free_dir_lookup_cache( dir_lookup_cache[i] );
+    }
+    dir_lookup_cache[i] = cache;
+    return cache;
+}
+
+
+/***********************************************************************
+ *           lookup_dir_cache
+ *
+ * Look for a file name in a directory lookup index, matching short names too
+ * if requested. Returns the Unix name of the first matching entry in readdir order.
+ */
+static const char *lookup_dir_cache( const struct dir_lookup_cache *cache, const WCHAR *name,
+                                     int length, BOOLEAN check_short )
+{
+    unsigned int i, found = DIR_LOOKUP_END, h;
+
+    h = hash_dir_lookup_name( name, length ) & (cache->hash_size - 1);
+    for (i = cache->long_hash[h]; i != DIR_LOOKUP_END; i = cache->long_next[i])
+    {
+        const WCHAR *long_name = cache->data->names[i].long_name;
+        if (!memicmpW( long_name, name, length ) && !long_name[length])
+        {
+            found = i;
+            break;
+        }
+    }
+    if (check_short)
+    {
+        for (i = cache->short_hash[h]; i < found; i = cache->short_next[i])
+        {
+            const WCHAR *short_name = cache->data->names[i].short_name;
+            if (!memicmpW( short_name, name, length ) && !short_name[length])
+            {
+                found = i;
+                break;
+            }
+        }
+    }
+    if (found == DIR_LOOKUP_END) return NULL;
+    return cache->data->names[found].unix_name;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2040,6 +2282,7 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     DIR *dir;
     struct dirent *de;
     struct stat st;
+    struct dir_lookup_cache *cache;
     int ret, used_default;
 
     /* try a shortcut for this directory */
@@ -2134,6 +2377,24 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
+    RtlEnterCriticalSection( &dir_section );
+    if ((cache = get_dir_lookup_cache( unix_name )))
+    {
+        const char *found = lookup_dir_cache( cache, name, length, is_name_8_dot_3 );
+
+        if (found)
+        {
+            dir_lookup_hits++;
+            unix_name[pos - 1] = '/';
+            strcpy( unix_name + pos, found );
+        }
+        else dir_lookup_misses++;
+        RtlLeaveCriticalSection( &dir_section );
+        if (found) goto success;
+        goto not_found;
+    }
+    RtlLeaveCriticalSection( &dir_section );
+
     if (!(dir = opendir( unix_name )))
     {
         if (errno == ENOENT) return STATUS_OBJECT_PATH_NOT_FOUND;
@@ -161,6 +161,7 @@ void esync_init(void)
     shm_addrs_size = 128;
 }
 
+/* Caller must hold fd_cache_section. */
 static void *get_shm( unsigned int idx )
 {
     int entry  = (idx * 8) / pagesize;
@@ -190,7 +191,8 @@ static void *get_shm( unsigned int idx )
 }
 
 /* We'd like lookup to be fast. To that end, we use a static list indexed by handle.
- * This is copied and adapted from the fd cache code. */
+ * This is copied and adapted from the fd cache code: lookups don't take any
+ * lock, entries are only filled while holding fd_cache_section. */
 
 #define ESYNC_LIST_BLOCK_SIZE  (65536 / sizeof(struct esync))
 #define ESYNC_LIST_ENTRIES     256
@@ -205,6 +207,9 @@ static inline UINT_PTR handle_to_index( HANDLE handle, UINT_PTR *entry )
     return idx % ESYNC_LIST_BLOCK_SIZE;
 }
 
+static LONG esync_cache_hits, esync_cache_misses;  /* only maintained when tracing */
+
+/* Caller must hold fd_cache_section. */
 static struct esync *add_to_list( HANDLE handle, enum esync_type type, int fd, void *shm )
 {
     UINT_PTR entry, idx = handle_to_index( handle, &entry );
@@ -220,17 +225,19 @@ static struct esync *add_to_list( HANDLE handle, enum esync_type type, int fd, v
         if (!entry) esync_list[0] = esync_list_initial_block;
         else
         {
-            void *ptr = wine_anon_mmap( NULL, ESYNC_LIST_BLOCK_SIZE * sizeof(struct esync *),
+            void *ptr = wine_anon_mmap( NULL, ESYNC_LIST_BLOCK_SIZE * sizeof(struct esync),
                                         PROT_READ | PROT_WRITE, 0 );
             if (ptr == MAP_FAILED) return FALSE;
             esync_list[entry] = ptr;
         }
     }
 
-    if (!interlocked_cmpxchg((int *)&esync_list[entry][idx].type, type, 0))
+    if (!esync_list[entry][idx].type)
     {
         esync_list[entry][idx].fd = fd;
         esync_list[entry][idx].shm = shm;
+        /* the type is set last, so that a lookup never sees a partial entry */
+        interlocked_xchg( (int *)&esync_list[entry][idx].type, type );
     }
     return &esync_list[entry][idx];
 }
@@ -261,7 +268,11 @@ static NTSTATUS get_object( HANDLE handle, struct esync **obj )
     sigset_t sigset;
     int fd = -1;
 
-    if ((*obj = get_cached_object( handle ))) return STATUS_SUCCESS;
+    if ((*obj = get_cached_object( handle )))
+    {
+        if (TRACE_ON(esync)) interlocked_xchg_add( &esync_cache_hits, 1 );
+        return STATUS_SUCCESS;
+    }
 
     if ((INT_PTR)handle < 0)
     {
@@ -285,14 +296,14 @@ static NTSTATUS get_object( HANDLE handle, struct esync **obj )
             }
         }
         SERVER_END_REQ;
-    }
-    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
 
-    if (*obj)
-    {
-        /* We managed to grab it while in the CS; return it. */
-        return STATUS_SUCCESS;
+        if (!ret)
+        {
+            *obj = add_to_list( handle, type, fd, shm_idx ? get_shm( shm_idx ) : 0 );
+            if (TRACE_ON(esync)) interlocked_xchg_add( &esync_cache_misses, 1 );
+        }
     }
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
 
     if (ret)
     {
@@ -301,9 +312,9 @@ static NTSTATUS get_object( HANDLE handle, struct esync **obj )
         return ret;
     }
 
-    TRACE("Got fd %d for handle %p.\n", fd, handle);
-
-    *obj = add_to_list( handle, type, fd, shm_idx ? get_shm( shm_idx ) : 0 );
+    if (fd != -1)
+        TRACE("Got fd %d for handle %p (cache hits %d, misses %d).\n",
+              fd, handle, esync_cache_hits, esync_cache_misses);
     return ret;
 }
 
@@ -359,14 +370,12 @@ static NTSTATUS create_esync( enum esync_type type, HANDLE *handle,
         }
     }
     SERVER_END_REQ;
-    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
-
     if (!ret || ret == STATUS_OBJECT_NAME_EXISTS)
-    {
         add_to_list( *handle, type, fd, shm_idx ? get_shm( shm_idx ) : 0 );
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
 
+    if (!ret || ret == STATUS_OBJECT_NAME_EXISTS)
         TRACE("-> handle %p, fd %d, shm index %d.\n", *handle, fd, shm_idx);
-    }
 
     RtlFreeHeap( GetProcessHeap(), 0, objattr );
     return ret;
@@ -400,14 +409,10 @@ static NTSTATUS open_esync( enum esync_type type, HANDLE *handle,
         }
     }
     SERVER_END_REQ;
+    if (!ret) add_to_list( *handle, type, fd, shm_idx ? get_shm( shm_idx ) : 0 );
     server_leave_uninterrupted_section( &fd_cache_section, &sigset );
 
-    if (!ret)
-    {
-        add_to_list( *handle, type, fd, shm_idx ? get_shm( shm_idx ) : 0 );
-
-        TRACE("-> handle %p, fd %d.\n", *handle, fd);
-    }
+    if (!ret) TRACE("-> handle %p, fd %d.\n", *handle, fd);
     return ret;
 }
 
@@ -1015,11 +1020,15 @@ NTSTATUS esync_wait_objects( DWORD count, const HANDLE *handles, BOOLEAN wait_an
 
     if (wait_any || count == 1)
     {
+        BOOL all_shm = TRUE;
+
         /* Try to check objects now, so we can obviate poll() at least. */
         for (i = 0; i < count; i++)
         {
             struct esync *obj = objs[i];
 
+            if (!obj || !obj->shm) all_shm = FALSE;
+
             if (obj)
             {
                 switch (obj->type)
@@ -1100,6 +1109,17 @@ NTSTATUS esync_wait_objects( DWORD count, const HANDLE *handles, BOOLEAN wait_an
             fds[i].fd = obj ? obj->fd : -1;
             fds[i].events = POLLIN;
         }
+
+        /* If the state of every object lives in the shm section, we now know
+         * that none of them could be grabbed. Polling with a timeout that
+         * already expired can't tell us anything more, so skip the system call
+         * for the common case of a zero timeout. */
+        if (all_shm && !msgwait && !alertable && timeout && !update_timeout( end ))
+        {
+            TRACE("Wait timed out.\n");
+            return STATUS_TIMEOUT;
+        }
+
         if (msgwait)
         {
             fds[i].fd = ntdll_get_thread_data()->esync_queue_fd;
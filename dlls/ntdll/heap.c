@@ -45,6 +45,7 @@
 #include "wine/server.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(heap);
+WINE_DECLARE_DEBUG_CHANNEL(heapstats);
 
 /* Note: the heap data structures are loosely based on what Pietrek describes in his
  * book 'Windows 95 System Programming Secrets', with some adaptations for
@@ -126,6 +127,14 @@ static const SIZE_T HEAP_freeListSizes[] =
 };
 #define HEAP_NB_FREE_LISTS (sizeof(HEAP_freeListSizes) / sizeof(HEAP_freeListSizes[0]) + HEAP_NB_SMALL_FREE_LISTS)
 
+/* The low-fragmentation front end caches freed blocks up to this size in lock-free lists */
+#define HEAP_MAX_LFH_BLOCK_SIZE 0x400
+#define HEAP_NB_LFH_BINS (((HEAP_MAX_LFH_BLOCK_SIZE - HEAP_MIN_DATA_SIZE) / ALIGNMENT) + 1)
+/* max amount of memory cached in a single LFH bin, and in all the bins of a heap;
+ * cached blocks are only released when the heap is destroyed */
+#define HEAP_MAX_LFH_BIN_BYTES 0x10000
+#define HEAP_MAX_LFH_BYTES     0x40000
+
 typedef union
 {
     ARENA_FREE  arena;
@@ -164,6 +173,8 @@ typedef struct tagHEAP
     ARENA_INUSE    **pending_free;  /* Ring buffer for pending free requests */
     RTL_CRITICAL_SECTION critSection; /* Critical section for serialization */
     FREE_LIST_ENTRY *freeList;      /* Free lists */
+    SLIST_HEADER    *lfh;           /* Low-fragmentation heap bins, if enabled */
+    LONG             lfh_bytes;     /* Size of the blocks cached in the LFH bins */
 } HEAP;
 
 #define HEAP_MAGIC       ((DWORD)('H' | ('E'<<8) | ('A'<<16) | ('P'<<24)))
@@ -401,6 +412,110 @@ static void HEAP_Dump( HEAP *heap )
 }
 
 
+/***********************************************************************
+ *           HEAP_DumpStats
+ *
+ * Print a summary of the heap usage on the heapstats channel. Unlike
+ * HEAP_Dump this doesn't list every block, so it can be used on large
+ * heaps. The heap lock must be held.
+ */
+#define HEAP_NB_STATS_BUCKETS 16  /* size classes by powers of two, starting at 32 bytes */
+
+static void HEAP_DumpStats( HEAP *heap )
+{
+    SIZE_T used_hist[HEAP_NB_STATS_BUCKETS] = { 0 }, free_hist[HEAP_NB_STATS_BUCKETS] = { 0 };
+    SIZE_T total_committed = 0, total_used = 0, total_free = 0, pending = 0;
+    SIZE_T large_count = 0, large_size = 0;
+    ARENA_LARGE *large;
+    SUBHEAP *subheap;
+    unsigned int i;
+    char *ptr;
+
+    TRACE_(heapstats)( "heap %p: flags %08x, %s, lock contention %u\n", heap, heap->flags,
+                       heap->lfh ? "LFH" : "standard",
+                       heap->critSection.DebugInfo ? heap->critSection.DebugInfo->ContentionCount : 0 );
+
+    LIST_FOR_EACH_ENTRY( subheap, &heap->subheap_list, SUBHEAP, entry )
+    {
+        SIZE_T free_size = 0, used_size = 0, largest_free = 0, used_count = 0, free_count = 0;
+
+        ptr = (char *)subheap->base + subheap->headerSize;
+        while (ptr < (char *)subheap->base + subheap->size)
+        {
+            SIZE_T size = *(DWORD *)ptr & ARENA_SIZE_MASK;
+
+            for (i = 0; i < HEAP_NB_STATS_BUCKETS - 1 && size >= ((SIZE_T)32 << i); i++) ;
+            if (*(DWORD *)ptr & ARENA_FLAG_FREE)
+            {
+                free_size += size;
+                free_count++;
+                free_hist[i]++;
+                if (size > largest_free) largest_free = size;
+                ptr += sizeof(ARENA_FREE) + size;
+            }
+            else
+            {
+                if (((ARENA_INUSE *)ptr)->magic == ARENA_PENDING_MAGIC) pending++;
+                used_size += size;
+                used_count++;
+                used_hist[i]++;
+                ptr += sizeof(ARENA_INUSE) + size;
+            }
+        }
+
+        TRACE_(heapstats)( "  subheap %p: size %08lx committed %08lx used %08lx in %lu blocks, "
+                           "free %08lx in %lu blocks, largest free %08lx, fragmentation %lu%%\n",
+                           subheap->base, subheap->size, subheap->commitSize, used_size, used_count,
+                           free_size, free_count, largest_free,
+                           free_size ? 100 - largest_free * 100 / free_size : 0 );
+        total_committed += subheap->commitSize;
+        total_used += used_size;
+        total_free += free_size;
+    }
+
+    LIST_FOR_EACH_ENTRY( large, &heap->large_list, ARENA_LARGE, entry )
+    {
+        large_count++;
+        large_size += large->block_size;
+    }
+
+    TRACE_(heapstats)( "  total: committed %08lx used %08lx free %08lx, %lu pending or cached blocks, "
+                       "%lu large blocks using %08lx\n", total_committed, total_used, total_free,
+                       pending, large_count, large_size );
+    for (i = 0; i < HEAP_NB_STATS_BUCKETS; i++)
+    {
+        if (!used_hist[i] && !free_hist[i]) continue;
+        TRACE_(heapstats)( "  size %s %8lx: %8lu used %8lu free\n",
+                           i < HEAP_NB_STATS_BUCKETS - 1 ? "< " : ">=",
+                           (SIZE_T)32 << (i < HEAP_NB_STATS_BUCKETS - 1 ? i : i - 1),
+                           used_hist[i], free_hist[i] );
+    }
+}
+
+
+/***********************************************************************
+ *           heap_dump_stats
+ *
+ * Print the usage summary of all the process heaps, if enabled.
+ */
+void heap_dump_stats(void)
+{
+    HEAP *heap;
+
+    if (!TRACE_ON(heapstats) || !processHeap) return;
+
+    RtlEnterCriticalSection( &processHeap->critSection );
+    HEAP_DumpStats( processHeap );
+    LIST_FOR_EACH_ENTRY( heap, &processHeap->entry, HEAP, entry )
+    {
+        RtlEnterCriticalSection( &heap->critSection );
+        HEAP_DumpStats( heap );
+        RtlLeaveCriticalSection( &heap->critSection );
+    }
+    RtlLeaveCriticalSection( &processHeap->critSection );
+}
+
+
 static void HEAP_DumpEntry( LPPROCESS_HEAP_ENTRY entry )
 {
     WORD rem_flags;
@@ -1289,6 +1404,9 @@ static BOOL HEAP_ValidateInUseArena( const SUBHEAP *subheap, const ARENA_INUSE *
         const DWORD *ptr = (const DWORD *)(pArena + 1);
         const DWORD *end = (const DWORD *)((const char *)ptr + size);
 
+        /* blocks cached by the LFH are not filled */
+        if (!(flags & HEAP_FREE_CHECKING_ENABLED)) return TRUE;
+
         while (ptr < end)
         {
             if (*ptr != ARENA_FREE_FILLER)
@@ -1447,6 +1565,99 @@ static BOOL validate_block_pointer( HEAP *heap, SUBHEAP **ret_subheap, const ARE
 }
 
 
+/***********************************************************************
+ *           lfh_alloc
+ *
+ * Try to allocate a block from the low-fragmentation heap bins, without
+ * taking the heap lock.
+ */
+static void *lfh_alloc( HEAP *heap, DWORD flags, SIZE_T size, SIZE_T rounded_size )
+{
+    SLIST_ENTRY *entry;
+    ARENA_INUSE *arena;
+
+    if (rounded_size > HEAP_MAX_LFH_BLOCK_SIZE) return NULL;
+    if (!(entry = RtlInterlockedPopEntrySList( &heap->lfh[(rounded_size - HEAP_MIN_DATA_SIZE) / ALIGNMENT] )))
+        return NULL;
+
+    arena = (ARENA_INUSE *)entry - 1;
+    interlocked_xchg_add( &heap->lfh_bytes, -(LONG)(arena->size & ARENA_SIZE_MASK) );
+    arena->magic = ARENA_INUSE_MAGIC;
+    arena->unused_bytes = (arena->size & ARENA_SIZE_MASK) - size;
+    notify_alloc( arena + 1, size, flags & HEAP_ZERO_MEMORY );
+    initialize_block( arena + 1, size, arena->unused_bytes, flags );
+    return arena + 1;
+}
+
+
+/***********************************************************************
+ *           lfh_free
+ *
+ * Try to put a small block into the low-fragmentation heap bins instead
+ * of freeing it. The block must have been validated as an in-use arena of
+ * one of the heap subheaps. Cached blocks are marked pending so that they
+ * are still seen as in-use arenas, and so that a double free is caught by
+ * the normal validation.
+ */
+static BOOL lfh_free( HEAP *heap, void *ptr )
+{
+    ARENA_INUSE *arena = (ARENA_INUSE *)ptr - 1;
+    ARENA_INUSE old_arena, new_arena;
+    SLIST_HEADER *bin;
+    DWORD size;
+
+    size = arena->size & ARENA_SIZE_MASK;
+    if (size < HEAP_MIN_DATA_SIZE || size > HEAP_MAX_LFH_BLOCK_SIZE) return FALSE;
+    if ((size - HEAP_MIN_DATA_SIZE) % ALIGNMENT) return FALSE;
+    bin = &heap->lfh[(size - HEAP_MIN_DATA_SIZE) / ALIGNMENT];
+    if (RtlQueryDepthSList( bin ) >= HEAP_MAX_LFH_BIN_BYTES / size) return FALSE;
+    if (heap->lfh_bytes + size > HEAP_MAX_LFH_BYTES) return FALSE;
+
+    /* atomically switch the magic so that concurrent frees of the same block can't both succeed */
+    old_arena = new_arena = *arena;
+    if (old_arena.magic != ARENA_INUSE_MAGIC) return FALSE;
+    new_arena.magic = ARENA_PENDING_MAGIC;
+    if (interlocked_cmpxchg( (LONG *)arena + 1, ((LONG *)&new_arena)[1], ((LONG *)&old_arena)[1] )
+        != ((LONG *)&old_arena)[1])
+        return FALSE;
+
+    interlocked_xchg_add( &heap->lfh_bytes, size );
+    RtlInterlockedPushEntrySList( bin, ptr );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           lfh_enable
+ *
+ * Enable the low-fragmentation heap front end. The heap lock must be held.
+ */
+static NTSTATUS lfh_enable( HEAP *heap )
+{
+    void *ptr = NULL;
+    SIZE_T size = HEAP_NB_LFH_BINS * sizeof(*heap->lfh);
+
+    if (heap->lfh) return STATUS_SUCCESS;
+
+    /* the LFH can't be used on non-growable or unserialized heaps */
+    if ((heap->flags & HEAP_NO_SERIALIZE) || !(heap->flags & HEAP_GROWABLE)) return STATUS_UNSUCCESSFUL;
+
+    /* keep using the normal allocator when debugging the heap */
+    if ((heap->flags & (HEAP_VALIDATE | HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED |
+                        HEAP_PAGE_ALLOCS)) || heap->pending_free || RUNNING_ON_VALGRIND)
+    {
+        WARN( "heap %p: not enabling the LFH on a debug heap\n", heap );
+        return STATUS_SUCCESS;
+    }
+
+    if (NtAllocateVirtualMemory( NtCurrentProcess(), &ptr, 4, &size, MEM_COMMIT, PAGE_READWRITE ))
+        return STATUS_NO_MEMORY;
+    heap->lfh = ptr;  /* allocated memory is already zeroed, which initializes the lists */
+    TRACE( "heap %p: enabled the LFH\n", heap );
+    return STATUS_SUCCESS;
+}
+
+
 /***********************************************************************
  *           heap_set_debug_flags
  */
@@ -1607,6 +1818,13 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
 
     if (heap == processHeap) return heap; /* cannot delete the main process heap */
 
+    if (TRACE_ON(heapstats))
+    {
+        RtlEnterCriticalSection( &heapPtr->critSection );
+        HEAP_DumpStats( heapPtr );
+        RtlLeaveCriticalSection( &heapPtr->critSection );
+    }
+
     /* remove it from the per-process list */
     RtlEnterCriticalSection( &processHeap->critSection );
     list_remove( &heapPtr->entry );
@@ -1638,6 +1856,12 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
         addr = heapPtr->pending_free;
         NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
     }
+    if (heapPtr->lfh)
+    {
+        size = 0;
+        addr = heapPtr->lfh;
+        NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+    }
     size = 0;
     addr = heapPtr->subheap.base;
     NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
@@ -1683,6 +1907,12 @@ PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
     }
     if (rounded_size < HEAP_MIN_DATA_SIZE) rounded_size = HEAP_MIN_DATA_SIZE;
 
+    if (heapPtr->lfh && (pInUse = lfh_alloc( heapPtr, flags, size, rounded_size )))
+    {
+        TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, pInUse );
+        return pInUse;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     if (rounded_size >= HEAP_MIN_LARGE_BLOCK_SIZE && (flags & HEAP_GROWABLE))
@@ -1766,6 +1996,7 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
 
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     /* Inform valgrind we are trying to free memory, so it can throw up an error message */
@@ -1777,7 +2008,7 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
 
     if (!subheap)
         free_large_block( heapPtr, flags, ptr );
-    else
+    else if (!heapPtr->lfh || !lfh_free( heapPtr, ptr ))
         HEAP_MakeInUseBlockFree( subheap, pInUse );
 
     if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
@@ -2246,6 +2477,8 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
                                          PVOID info, SIZE_T size_in, PSIZE_T size_out)
 {
+    HEAP *heapPtr;
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
@@ -2254,7 +2487,8 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        heapPtr = HEAP_GetPtr( heap );
+        *(ULONG *)info = (heapPtr && heapPtr->lfh) ? 2 : 0; /* LFH or standard heap */
         return STATUS_SUCCESS;
 
     default:
@@ -2268,6 +2502,18 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
  */
 NTSTATUS WINAPI RtlSetHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class, PVOID info, SIZE_T size)
 {
+    HEAP *heapPtr;
+    NTSTATUS status;
+
+    if (info_class == HeapCompatibilityInformation && size >= sizeof(ULONG) && *(ULONG *)info == 2)
+    {
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+        RtlEnterCriticalSection( &heapPtr->critSection );
+        status = lfh_enable( heapPtr );
+        RtlLeaveCriticalSection( &heapPtr->critSection );
+        return status;
+    }
+
     FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
     return STATUS_SUCCESS;
 }
@@ -49,6 +49,7 @@ WINE_DECLARE_DEBUG_CHANNEL(relay);
 WINE_DECLARE_DEBUG_CHANNEL(snoop);
 WINE_DECLARE_DEBUG_CHANNEL(loaddll);
 WINE_DECLARE_DEBUG_CHANNEL(imports);
+WINE_DECLARE_DEBUG_CHANNEL(loadtime);
 
 #ifdef _WIN64
 #define DEFAULT_SECURITY_COOKIE_64  (((ULONGLONG)0x00002b99 << 32) | 0x2ddfa232)
@@ -92,8 +93,37 @@ typedef struct _wine_modref
     int                   alloc_deps;
     int                   nDeps;
     struct _wine_modref **deps;
+    LIST_ENTRY            basename_hash;  /* entry in the base name hash table */
+    LIST_ENTRY            fullname_hash;  /* entry in the full name hash table */
+    struct forward_cache *forwards;       /* cache of resolved forwarded exports */
+    ULONGLONG             map_time;       /* time spent mapping the image (loadtime channel) */
+    ULONGLONG             reloc_time;     /* time spent applying relocations */
+    ULONGLONG             import_time;    /* time spent resolving imports, including dependencies */
+    ULONGLONG             init_time;      /* time spent in the DLL_PROCESS_ATTACH notification */
 } WINE_MODREF;
 
+/* hash tables for looking up modules by name, in load order within each bucket */
+#define MODULE_HASH_SIZE 64
+
+static LIST_ENTRY basename_hash_table[MODULE_HASH_SIZE];
+static LIST_ENTRY fullname_hash_table[MODULE_HASH_SIZE];
+
+/* per-module cache of forwarded exports, indexed by the address of the forward string */
+#define FORWARD_CACHE_SIZE 32
+
+struct forward_cache
+{
+    unsigned int generation;  /* value of forward_cache_generation when filled */
+    struct
+    {
+        const char *forward;
+        FARPROC     proc;
+    } entries[FORWARD_CACHE_SIZE];
+};
+
+/* bumped whenever a module is unloaded, which invalidates all the cached forwards */
+static unsigned int forward_cache_generation;
+
 /* info about the current builtin dll load */
 /* used to keep track of things across the register_dll constructor call */
 struct builtin_load_info
@@ -102,6 +132,7 @@ struct builtin_load_info
     const WCHAR *filename;
     NTSTATUS     status;
     WINE_MODREF *wm;
+    ULONGLONG    start_time;
 };
 
 static struct builtin_load_info default_load_info;
@@ -131,6 +162,17 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
                                     DWORD exp_size, DWORD ordinal, LPCWSTR load_path );
 static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
                                   DWORD exp_size, const char *name, int hint, LPCWSTR load_path );
+static FARPROC find_cached_forwarded_export( HMODULE module, const char *forward, LPCWSTR load_path );
+
+/* current time in 100ns units if the loadtime channel is enabled */
+static inline ULONGLONG loadtime_now(void)
+{
+    LARGE_INTEGER counter;
+
+    if (!TRACE_ON(loadtime)) return 0;
+    NtQueryPerformanceCounter( &counter, NULL );
+    return counter.QuadPart;
+}
 
 /* convert PE image VirtualAddress to Real Address */
 static inline void *get_rva( HMODULE module, DWORD va )
@@ -367,6 +409,66 @@ static WINE_MODREF *get_modref( HMODULE hmod )
 }
 
 
+/**********************************************************************
+ *	    hash_module_name
+ *
+ * Case-insensitive hash of a module name, folding case the same way as
+ * strcmpiW() so that names comparing equal always hash to the same bucket.
+ */
+static unsigned int hash_module_name( LPCWSTR name )
+{
+    unsigned int hash = 0;
+
+    while (*name) hash = hash * 65599 + tolowerW( *name++ );
+    return hash % MODULE_HASH_SIZE;
+}
+
+
+/**********************************************************************
+ *	    init_module_hash_tables
+ */
+static void init_module_hash_tables(void)
+{
+    unsigned int i;
+
+    if (basename_hash_table[0].Flink) return;
+    for (i = 0; i < MODULE_HASH_SIZE; i++)
+    {
+        InitializeListHead( &basename_hash_table[i] );
+        InitializeListHead( &fullname_hash_table[i] );
+    }
+}
+
+
+/**********************************************************************
+ *	    insert_module_hash
+ *
+ * Add a module to the name hash tables.
+ * The loader_section must be locked while calling this function
+ */
+static void insert_module_hash( WINE_MODREF *wm )
+{
+    init_module_hash_tables();
+    InsertTailList( &basename_hash_table[hash_module_name( wm->ldr.BaseDllName.Buffer )],
+                    &wm->basename_hash );
+    InsertTailList( &fullname_hash_table[hash_module_name( wm->ldr.FullDllName.Buffer )],
+                    &wm->fullname_hash );
+}
+
+
+/**********************************************************************
+ *	    remove_module_hash
+ *
+ * Remove a module from the name hash tables.
+ * The loader_section must be locked while calling this function
+ */
+static void remove_module_hash( WINE_MODREF *wm )
+{
+    RemoveEntryList( &wm->basename_hash );
+    RemoveEntryList( &wm->fullname_hash );
+}
+
+
 /**********************************************************************
  *	    find_basename_module
  *
@@ -380,13 +482,14 @@ static WINE_MODREF *find_basename_module( LPCWSTR name )
     if (cached_modref && !strcmpiW( name, cached_modref->ldr.BaseDllName.Buffer ))
         return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
+    init_module_hash_tables();
+    mark = &basename_hash_table[hash_module_name( name )];
     for (entry = mark->Flink; entry != mark; entry = entry->Flink)
     {
-        LDR_MODULE *mod = CONTAINING_RECORD(entry, LDR_MODULE, InLoadOrderModuleList);
-        if (!strcmpiW( name, mod->BaseDllName.Buffer ))
+        WINE_MODREF *wm = CONTAINING_RECORD(entry, WINE_MODREF, basename_hash);
+        if (!strcmpiW( name, wm->ldr.BaseDllName.Buffer ))
         {
-            cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
+            cached_modref = wm;
             return cached_modref;
         }
     }
@@ -407,13 +510,14 @@ static WINE_MODREF *find_fullname_module( LPCWSTR name )
     if (cached_modref && !strcmpiW( name, cached_modref->ldr.FullDllName.Buffer ))
         return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
+    init_module_hash_tables();
+    mark = &fullname_hash_table[hash_module_name( name )];
     for (entry = mark->Flink; entry != mark; entry = entry->Flink)
     {
-        LDR_MODULE *mod = CONTAINING_RECORD(entry, LDR_MODULE, InLoadOrderModuleList);
-        if (!strcmpiW( name, mod->FullDllName.Buffer ))
+        WINE_MODREF *wm = CONTAINING_RECORD(entry, WINE_MODREF, fullname_hash);
+        if (!strcmpiW( name, wm->ldr.FullDllName.Buffer ))
         {
-            cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
+            cached_modref = wm;
             return cached_modref;
         }
     }
@@ -531,6 +635,47 @@ static FARPROC find_forwarded_export( HMODULE module, const char *forward, LPCWS
 }
 
 
+/*************************************************************************
+ *		find_cached_forwarded_export
+ *
+ * Find the final function pointer for a forwarded function, going through
+ * the forwarding module's cache of already resolved forwards.
+ * The loader_section must be locked while calling this function.
+ */
+static FARPROC find_cached_forwarded_export( HMODULE module, const char *forward, LPCWSTR load_path )
+{
+    WINE_MODREF *wm;
+    struct forward_cache *cache;
+    unsigned int index;
+    FARPROC proc;
+
+    /* relay and snoop thunks depend on the importing module, don't cache them */
+    if (TRACE_ON(relay) || TRACE_ON(snoop) || !(wm = get_modref( module )))
+        return find_forwarded_export( module, forward, load_path );
+
+    index = ((ULONG_PTR)forward >> 2) % FORWARD_CACHE_SIZE;
+    if ((cache = wm->forwards) && cache->generation == forward_cache_generation &&
+        cache->entries[index].forward == forward)
+        return cache->entries[index].proc;
+
+    if (!(proc = find_forwarded_export( module, forward, load_path ))) return NULL;
+
+    if (!(cache = wm->forwards))
+        cache = wm->forwards = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cache) );
+    if (cache)
+    {
+        if (cache->generation != forward_cache_generation)
+        {
+            memset( cache->entries, 0, sizeof(cache->entries) );
+            cache->generation = forward_cache_generation;
+        }
+        cache->entries[index].forward = forward;
+        cache->entries[index].proc = proc;
+    }
+    return proc;
+}
+
+
 /*************************************************************************
  *		find_ordinal_export
  *
@@ -556,7 +701,7 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
     /* if the address falls into the export dir, it's a forward */
     if (((const char *)proc >= (const char *)exports) && 
         ((const char *)proc < (const char *)exports + exp_size))
-        return find_forwarded_export( module, (const char *)proc, load_path );
+        return find_cached_forwarded_export( module, (const char *)proc, load_path );
 
     if (TRACE_ON(snoop))
     {
@@ -1062,6 +1207,7 @@ static WINE_MODREF *alloc_module( HMODULE hModule, LPCWSTR filename )
                    &wm->ldr.InLoadOrderModuleList);
     InsertTailList(&NtCurrentTeb()->Peb->LdrData->InMemoryOrderModuleList,
                    &wm->ldr.InMemoryOrderModuleList);
+    insert_module_hash( wm );
     /* wait until init is called for inserting into InInitializationOrderModuleList */
 
     if (!(nt->OptionalHeader.DllCharacteristics & IMAGE_DLLCHARACTERISTICS_NX_COMPAT))
@@ -1274,8 +1420,14 @@ static NTSTATUS process_attach( WINE_MODREF *wm, LPVOID lpReserved )
     if (status == STATUS_SUCCESS)
     {
         WINE_MODREF *prev = current_modref;
+        ULONGLONG start = loadtime_now();
         current_modref = wm;
         status = MODULE_InitDLL( wm, DLL_PROCESS_ATTACH, lpReserved );
+        wm->init_time = loadtime_now() - start;
+        TRACE_(loadtime)( "%s: map %uus reloc %uus imports %uus init %uus\n",
+                          debugstr_w(wm->ldr.FullDllName.Buffer),
+                          (unsigned int)(wm->map_time / 10), (unsigned int)(wm->reloc_time / 10),
+                          (unsigned int)(wm->import_time / 10), (unsigned int)(wm->init_time / 10) );
         if (status == STATUS_SUCCESS)
             wm->ldr.Flags |= LDR_PROCESS_ATTACHED;
         else
@@ -1633,6 +1785,7 @@ static void load_builtin_callback( void *module, const char *filename )
     WINE_MODREF *wm;
     WCHAR *fullname;
     const WCHAR *load_path;
+    NTSTATUS status;
 
     if (!module)
     {
@@ -1666,21 +1819,27 @@ static void load_builtin_callback( void *module, const char *filename )
         return;
     }
     wm->ldr.Flags |= LDR_WINE_INTERNAL;
+    if (builtin_load_info->start_time) wm->map_time = loadtime_now() - builtin_load_info->start_time;
 
     if ((nt->FileHeader.Characteristics & IMAGE_FILE_DLL) ||
         nt->OptionalHeader.Subsystem == IMAGE_SUBSYSTEM_NATIVE ||
         is_16bit_builtin( module ))
     {
+        ULONGLONG start = loadtime_now();
+
         /* fixup imports */
 
         load_path = builtin_load_info->load_path;
         if (!load_path) load_path = NtCurrentTeb()->Peb->ProcessParameters->DllPath.Buffer;
         if (!load_path) load_path = emptyW;
-        if (fixup_imports( wm, load_path ) != STATUS_SUCCESS)
+        status = fixup_imports( wm, load_path );
+        wm->import_time = loadtime_now() - start;
+        if (status != STATUS_SUCCESS)
         {
             /* the module has only be inserted in the load & memory order lists */
             RemoveEntryList(&wm->ldr.InLoadOrderModuleList);
             RemoveEntryList(&wm->ldr.InMemoryOrderModuleList);
+            remove_module_hash( wm );
             /* FIXME: free the modref */
             builtin_load_info->status = STATUS_DLL_NOT_FOUND;
             return;
@@ -1878,6 +2037,7 @@ static NTSTATUS load_native_dll( LPCWSTR load_path, LPCWSTR name, HANDLE file,
     WINE_MODREF *wm;
     NTSTATUS status;
     pe_image_info_t image_info;
+    ULONGLONG start = loadtime_now(), map_time, reloc_time = 0;
 
     TRACE("Trying native dll %s\n", debugstr_w(name));
 
@@ -1898,10 +2058,16 @@ static NTSTATUS load_native_dll( LPCWSTR load_path, LPCWSTR name, HANDLE file,
         return STATUS_INVALID_IMAGE_FORMAT;
     }
 
+    map_time = loadtime_now() - start;
+
     /* perform base relocation, if necessary */
 
     if (status == STATUS_IMAGE_NOT_AT_BASE)
+    {
+        start = loadtime_now();
         status = perform_relocations( module, len );
+        reloc_time = loadtime_now() - start;
+    }
 
     if (status != STATUS_SUCCESS)
     {
@@ -1919,6 +2085,8 @@ static NTSTATUS load_native_dll( LPCWSTR load_path, LPCWSTR name, HANDLE file,
 
     wm->dev = st->st_dev;
     wm->ino = st->st_ino;
+    wm->map_time = map_time;
+    wm->reloc_time = reloc_time;
     if (image_info.loader_flags) wm->ldr.Flags |= LDR_COR_IMAGE;
     if (image_info.image_flags & IMAGE_FLAGS_ComPlusILOnly) wm->ldr.Flags |= LDR_COR_ILONLY;
 
@@ -1932,15 +2100,18 @@ static NTSTATUS load_native_dll( LPCWSTR load_path, LPCWSTR name, HANDLE file,
         ((nt->FileHeader.Characteristics & IMAGE_FILE_DLL) ||
          nt->OptionalHeader.Subsystem == IMAGE_SUBSYSTEM_NATIVE))
     {
+        start = loadtime_now();
         if (wm->ldr.Flags & LDR_COR_ILONLY)
             status = fixup_imports_ilonly( wm, load_path, &wm->ldr.EntryPoint );
         else
             status = fixup_imports( wm, load_path );
+        wm->import_time = loadtime_now() - start;
         if (status != STATUS_SUCCESS)
         {
             /* the module has only be inserted in the load & memory order lists */
             RemoveEntryList(&wm->ldr.InLoadOrderModuleList);
             RemoveEntryList(&wm->ldr.InMemoryOrderModuleList);
+            remove_module_hash( wm );
 
             /* FIXME: there are several more dangling references
              * left. Including dlls loaded by this dll before the
@@ -2002,6 +2173,7 @@ static NTSTATUS load_builtin_dll( LPCWSTR load_path, LPCWSTR path, HANDLE file,
     info.filename  = NULL;
     info.status    = STATUS_SUCCESS;
     info.wm        = NULL;
+    info.start_time = loadtime_now();
 
     if (file)  /* we have a real file, try to load it */
     {
@@ -2872,6 +3044,7 @@ void WINAPI LdrShutdownProcess(void)
     TRACE("()\n");
     process_detaching = TRUE;
     process_detach();
+    heap_dump_stats();
 }
 
 
@@ -2945,6 +3118,8 @@ static void free_modref( WINE_MODREF *wm )
     RemoveEntryList(&wm->ldr.InMemoryOrderModuleList);
     if (wm->ldr.InInitializationOrderModuleList.Flink)
         RemoveEntryList(&wm->ldr.InInitializationOrderModuleList);
+    remove_module_hash( wm );
+    forward_cache_generation++;
 
     TRACE(" unloading %s\n", debugstr_w(wm->ldr.FullDllName.Buffer));
     if (!TRACE_ON(module))
@@ -2966,6 +3141,7 @@ static void free_modref( WINE_MODREF *wm )
     if (cached_modref == wm) cached_modref = NULL;
     RtlFreeUnicodeString( &wm->ldr.FullDllName );
     RtlFreeHeap( GetProcessHeap(), 0, wm->deps );
+    RtlFreeHeap( GetProcessHeap(), 0, wm->forwards );
     RtlFreeHeap( GetProcessHeap(), 0, wm );
 }
 
@@ -3270,6 +3446,12 @@ void WINAPI LdrInitializeThunk( void *kernel_start, ULONG_PTR unknown2,
     InsertHeadList( &peb->LdrData->InLoadOrderModuleList, &wm->ldr.InLoadOrderModuleList );
     RemoveEntryList( &wm->ldr.InMemoryOrderModuleList );
     InsertHeadList( &peb->LdrData->InMemoryOrderModuleList, &wm->ldr.InMemoryOrderModuleList );
+    remove_module_hash( wm );
+    init_module_hash_tables();
+    InsertHeadList( &basename_hash_table[hash_module_name( wm->ldr.BaseDllName.Buffer )],
+                    &wm->basename_hash );
+    InsertHeadList( &fullname_hash_table[hash_module_name( wm->ldr.FullDllName.Buffer )],
+                    &wm->fullname_hash );
 
     if ((status = virtual_alloc_thread_stack( NtCurrentTeb(), 0, 0, NULL )) != STATUS_SUCCESS)
     {
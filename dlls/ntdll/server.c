@@ -264,6 +264,41 @@ static void read_reply_data( void *buffer, size_t size )
 }
 
 
+/***********************************************************************
+ *           read_reply_header
+ *
+ * Read the reply header, along with whatever part of the variable size
+ * data is already available; helper for wait_reply.
+ * Returns the amount of variable size data that was read.
+ */
+static data_size_t read_reply_header( struct __server_request_info *req, data_size_t max_size )
+{
+    struct iovec vec[2];
+    int ret;
+
+    vec[0].iov_base = &req->u.reply;
+    vec[0].iov_len  = sizeof(req->u.reply);
+    vec[1].iov_base = req->reply_data;
+    vec[1].iov_len  = max_size;
+
+    for (;;)
+    {
+        if ((ret = readv( ntdll_get_thread_data()->reply_fd, vec, max_size ? 2 : 1 )) > 0)
+        {
+            if (ret >= sizeof(req->u.reply)) return ret - sizeof(req->u.reply);
+            read_reply_data( (char *)&req->u.reply + ret, sizeof(req->u.reply) - ret );
+            return 0;
+        }
+        if (!ret) break;
+        if (errno == EINTR) continue;
+        if (errno == EPIPE) break;
+        server_protocol_perror("read");
+    }
+    /* the server closed the connection; time to die... */
+    abort_thread(0);
+}
+
+
 /***********************************************************************
  *           wait_reply
  *
@@ -271,9 +306,11 @@ static void read_reply_data( void *buffer, size_t size )
  */
 static inline unsigned int wait_reply( struct __server_request_info *req )
 {
-    read_reply_data( &req->u.reply, sizeof(req->u.reply) );
-    if (req->u.reply.reply_header.reply_size)
-        read_reply_data( req->reply_data, req->u.reply.reply_header.reply_size );
+    data_size_t max_size = req->u.req.request_header.reply_size;  /* overwritten by the reply */
+    data_size_t size = read_reply_header( req, max_size );
+
+    if (req->u.reply.reply_header.reply_size > size)
+        read_reply_data( (char *)req->reply_data + size, req->u.reply.reply_header.reply_size - size );
     return req->u.reply.reply_header.error;
 }
 
@@ -828,6 +865,7 @@ C_ASSERT( sizeof(union fd_cache_entry) == sizeof(LONG64) );
 
 static union fd_cache_entry *fd_cache[FD_CACHE_ENTRIES];
 static union fd_cache_entry fd_cache_initial_block[FD_CACHE_BLOCK_SIZE];
+static LONG fd_cache_hits, fd_cache_misses;  /* only maintained when tracing */
 
 static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
 {
@@ -939,12 +977,22 @@ int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
     wanted_access &= FILE_READ_DATA | FILE_WRITE_DATA | FILE_APPEND_DATA;
 
     ret = get_cached_fd( handle, &fd, type, &access, options );
-    if (ret != STATUS_INVALID_HANDLE) goto done;
+    if (ret != STATUS_INVALID_HANDLE)
+    {
+        if (TRACE_ON(server)) interlocked_xchg_add( &fd_cache_hits, 1 );
+        goto done;
+    }
 
     server_enter_uninterrupted_section( &fd_cache_section, &sigset );
     ret = get_cached_fd( handle, &fd, type, &access, options );
     if (ret == STATUS_INVALID_HANDLE)
     {
+        if (TRACE_ON(server))
+        {
+            LONG misses = interlocked_xchg_add( &fd_cache_misses, 1 ) + 1;
+            TRACE( "fd cache miss for %p (hits %d, misses %d)\n", handle, fd_cache_hits, misses );
+        }
+
         SERVER_START_REQ( get_handle_fd )
         {
             req->handle = wine_server_obj_handle( handle );
@@ -42,6 +42,10 @@
 #ifdef HAVE_SCHED_H
 # include <sched.h>
 #endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#include <limits.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -63,6 +67,8 @@ WINE_DEFAULT_DEBUG_CHANNEL(ntdll);
 
 HANDLE keyed_event = NULL;
 
+#define TICKSPERSEC 10000000
+
 static inline int interlocked_dec_if_nonzero( int *dest )
 {
     int val, tmp;
@@ -1603,6 +1609,352 @@ DWORD WINAPI RtlRunOnceExecuteOnce( RTL_RUN_ONCE *once, PRTL_RUN_ONCE_INIT_FN fu
 }
 
 
+#ifdef __linux__
+
+static int wait_op = 128; /*FUTEX_WAIT|FUTEX_PRIVATE_FLAG*/
+static int wake_op = 129; /*FUTEX_WAKE|FUTEX_PRIVATE_FLAG*/
+static int wait_bitset_op = 137; /*FUTEX_WAIT_BITSET|FUTEX_PRIVATE_FLAG*/
+static int wake_bitset_op = 138; /*FUTEX_WAKE_BITSET|FUTEX_PRIVATE_FLAG*/
+
+static inline int futex_wait( int *addr, int val, struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, wait_op, val, timeout, 0, 0 );
+}
+
+static inline int futex_wake( int *addr, int val )
+{
+    return syscall( __NR_futex, addr, wake_op, val, NULL, 0, 0 );
+}
+
+static inline int futex_wait_bitset( int *addr, int val, int mask )
+{
+    return syscall( __NR_futex, addr, wait_bitset_op, val, NULL, 0, mask );
+}
+
+static inline int futex_wake_bitset( int *addr, int val, int mask )
+{
+    return syscall( __NR_futex, addr, wake_bitset_op, val, NULL, 0, mask );
+}
+
+static inline int use_futexes(void)
+{
+    static int supported = -1;
+
+    if (supported == -1)
+    {
+        futex_wait( &supported, 10, NULL );
+        if (errno == ENOSYS)
+        {
+            wait_op = 0; /*FUTEX_WAIT*/
+            wake_op = 1; /*FUTEX_WAKE*/
+            wait_bitset_op = 9; /*FUTEX_WAIT_BITSET*/
+            wake_bitset_op = 10; /*FUTEX_WAKE_BITSET*/
+            futex_wait( &supported, 10, NULL );
+        }
+        supported = (errno != ENOSYS);
+    }
+    return supported;
+}
+
+/* Futex-based SRW lock implementation
+ *
+ * The kernel keeps track of the waiting threads, so there is no need to
+ * count them in the lock word the way the keyed event implementation below
+ * does, and the whole lock is a single word that threads wait on with
+ * separate futex bitsets for exclusive and shared waiters:
+ *
+ *    31 - set if the lock is owned exclusively.
+ * 30-16 - number of threads waiting for exclusive access.
+ *    15 - set if there are threads waiting for shared access; only used to
+ *         avoid waking up shared waiters needlessly.
+ *  14-0 - number of threads owning the lock in shared mode.
+ *
+ * Shared acquirers wait as long as there are exclusive waiters, so that
+ * exclusive threads aren't starved by a steady stream of shared owners.
+ */
+
+#define SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT        0x80000000
+#define SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK    0x7fff0000
+#define SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_INC     0x00010000
+#define SRWLOCK_FUTEX_SHARED_WAITERS_BIT        0x00008000
+#define SRWLOCK_FUTEX_SHARED_OWNERS_MASK        0x00007fff
+#define SRWLOCK_FUTEX_SHARED_OWNERS_INC         0x00000001
+
+/* futex bitsets, independent from the bits of the lock word */
+#define SRWLOCK_FUTEX_BITSET_EXCLUSIVE  1
+#define SRWLOCK_FUTEX_BITSET_SHARED     2
+
+static NTSTATUS fast_try_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    int old, new;
+    NTSTATUS ret;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = *(int *)lock;
+
+        if (!(old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) && !(old & SRWLOCK_FUTEX_SHARED_OWNERS_MASK))
+        {
+            new = old | SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT;
+            ret = STATUS_SUCCESS;
+        }
+        else
+        {
+            new = old;
+            ret = STATUS_TIMEOUT;
+        }
+    } while (interlocked_cmpxchg( (int *)lock, new, old ) != old);
+
+    return ret;
+}
+
+static NTSTATUS fast_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    int old, new;
+    BOOL wait;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    /* register ourselves as an exclusive waiter */
+    do
+    {
+        old = *(int *)lock;
+        new = old + SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_INC;
+        if (!(new & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK)) RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+    } while (interlocked_cmpxchg( (int *)lock, new, old ) != old);
+
+    for (;;)
+    {
+        do
+        {
+            old = *(int *)lock;
+
+            if (!(old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) && !(old & SRWLOCK_FUTEX_SHARED_OWNERS_MASK))
+            {
+                new = (old | SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) - SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_INC;
+                wait = FALSE;
+            }
+            else
+            {
+                new = old;
+                wait = TRUE;
+            }
+        } while (interlocked_cmpxchg( (int *)lock, new, old ) != old);
+
+        if (!wait) return STATUS_SUCCESS;
+        futex_wait_bitset( (int *)lock, new, SRWLOCK_FUTEX_BITSET_EXCLUSIVE );
+    }
+}
+
+static NTSTATUS fast_try_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    int old, new;
+    NTSTATUS ret;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = *(int *)lock;
+
+        if (!(old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) && !(old & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK))
+        {
+            new = old + SRWLOCK_FUTEX_SHARED_OWNERS_INC;
+            if (!(new & SRWLOCK_FUTEX_SHARED_OWNERS_MASK)) RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+            ret = STATUS_SUCCESS;
+        }
+        else
+        {
+            new = old;
+            ret = STATUS_TIMEOUT;
+        }
+    } while (interlocked_cmpxchg( (int *)lock, new, old ) != old);
+
+    return ret;
+}
+
+static NTSTATUS fast_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    int old, new;
+    BOOL wait;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    for (;;)
+    {
+        do
+        {
+            old = *(int *)lock;
+
+            if (!(old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) && !(old & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK))
+            {
+                new = old + SRWLOCK_FUTEX_SHARED_OWNERS_INC;
+                if (!(new & SRWLOCK_FUTEX_SHARED_OWNERS_MASK)) RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+                wait = FALSE;
+            }
+            else
+            {
+                new = old | SRWLOCK_FUTEX_SHARED_WAITERS_BIT;
+                wait = TRUE;
+            }
+        } while (interlocked_cmpxchg( (int *)lock, new, old ) != old);
+
+        if (!wait) return STATUS_SUCCESS;
+        futex_wait_bitset( (int *)lock, new, SRWLOCK_FUTEX_BITSET_SHARED );
+    }
+}
+
+static NTSTATUS fast_release_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    int old, new;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = *(int *)lock;
+
+        if (!(old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT))
+        {
+            ERR( "lock %p is not owned exclusively (%#x)\n", lock, old );
+            return STATUS_RESOURCE_NOT_OWNED;
+        }
+
+        new = old & ~SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT;
+        if (!(new & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK))
+            new &= ~SRWLOCK_FUTEX_SHARED_WAITERS_BIT;
+    } while (interlocked_cmpxchg( (int *)lock, new, old ) != old);
+
+    /* exclusive waiters are processed first, followed by the shared waiters */
+    if (new & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK)
+        futex_wake_bitset( (int *)lock, 1, SRWLOCK_FUTEX_BITSET_EXCLUSIVE );
+    else if (old & SRWLOCK_FUTEX_SHARED_WAITERS_BIT)
+        futex_wake_bitset( (int *)lock, INT_MAX, SRWLOCK_FUTEX_BITSET_SHARED );
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_release_srw_shared( RTL_SRWLOCK *lock )
+{
+    int old, new;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = *(int *)lock;
+
+        if ((old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) || !(old & SRWLOCK_FUTEX_SHARED_OWNERS_MASK))
+        {
+            ERR( "lock %p is not owned shared (%#x)\n", lock, old );
+            return STATUS_RESOURCE_NOT_OWNED;
+        }
+
+        new = old - SRWLOCK_FUTEX_SHARED_OWNERS_INC;
+    } while (interlocked_cmpxchg( (int *)lock, new, old ) != old);
+
+    /* wake up one exclusive thread as soon as the last shared owner has left */
+    if (!(new & SRWLOCK_FUTEX_SHARED_OWNERS_MASK) && (new & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK))
+        futex_wake_bitset( (int *)lock, 1, SRWLOCK_FUTEX_BITSET_EXCLUSIVE );
+
+    return STATUS_SUCCESS;
+}
+
+/* Futex-based condition variables
+ *
+ * With futexes the condition variable is a wake-up sequence counter: a
+ * sleeper samples it while still holding the lock, and waits for it to
+ * change. Spurious wake-ups are allowed by the API, so there is no need to
+ * count the waiters like the keyed event implementation does.
+ */
+
+static NTSTATUS fast_sleep_cv( RTL_CONDITION_VARIABLE *variable, int val, const LARGE_INTEGER *timeout )
+{
+    struct timespec timespec, *ts = NULL;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    if (timeout && timeout->QuadPart != TIMEOUT_INFINITE)
+    {
+        LONGLONG diff = timeout->QuadPart;
+
+        if (diff >= 0)
+        {
+            LARGE_INTEGER now;
+            NtQuerySystemTime( &now );
+            diff = now.QuadPart - diff;
+            if (diff > 0) diff = 0;
+        }
+        timespec.tv_sec  = -diff / TICKSPERSEC;
+        timespec.tv_nsec = (-diff % TICKSPERSEC) * 100;
+        ts = &timespec;
+    }
+
+    if (futex_wait( (int *)&variable->Ptr, val, ts ) == -1 && errno == ETIMEDOUT)
+        return STATUS_TIMEOUT;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_wake_cv( RTL_CONDITION_VARIABLE *variable, int count )
+{
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    interlocked_xchg_add( (int *)&variable->Ptr, 1 );
+    futex_wake( (int *)&variable->Ptr, count );
+    return STATUS_SUCCESS;
+}
+
+#else  /* __linux__ */
+
+static inline int use_futexes(void)
+{
+    return 0;
+}
+
+static inline NTSTATUS fast_try_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static inline NTSTATUS fast_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static inline NTSTATUS fast_try_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static inline NTSTATUS fast_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static inline NTSTATUS fast_release_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static inline NTSTATUS fast_release_srw_shared( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static inline NTSTATUS fast_sleep_cv( RTL_CONDITION_VARIABLE *variable, int val, const LARGE_INTEGER *timeout )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static inline NTSTATUS fast_wake_cv( RTL_CONDITION_VARIABLE *variable, int count )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif  /* __linux__ */
+
 /* SRW locks implementation
  *
  * The memory layout used by the lock is:
@@ -1730,9 +2082,10 @@ static inline void srwlock_leave_shared( RTL_SRWLOCK *lock, unsigned int val )
  * NOTES
  *  Please note that SRWLocks do not keep track of the owner of a lock.
  *  It doesn't make any difference which thread for example unlocks an
- *  SRWLock (see corresponding tests). This implementation uses two
- *  keyed events (one for the exclusive waiters and one for the shared
- *  waiters) and is limited to 2^15-1 waiting threads.
+ *  SRWLock (see corresponding tests). This implementation uses futexes
+ *  when they are available, and otherwise two keyed events (one for the
+ *  exclusive waiters and one for the shared waiters). It is limited to
+ *  2^15-1 waiting threads.
  */
 void WINAPI RtlInitializeSRWLock( RTL_SRWLOCK *lock )
 {
@@ -1749,6 +2102,9 @@ void WINAPI RtlInitializeSRWLock( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 {
+    if (fast_acquire_srw_exclusive( lock ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     if (srwlock_lock_exclusive( (unsigned int *)&lock->Ptr, SRWLOCK_RES_EXCLUSIVE ))
         NtWaitForKeyedEvent( keyed_event, srwlock_key_exclusive(lock), FALSE, NULL );
 }
@@ -1763,6 +2119,10 @@ void WINAPI RtlAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
 {
     unsigned int val, tmp;
+
+    if (fast_acquire_srw_shared( lock ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     /* Acquires a shared lock. If it's currently not possible to add elements to
      * the shared queue, then request exclusive access instead. */
     for (val = *(unsigned int *)&lock->Ptr;; val = tmp)
@@ -1793,6 +2153,9 @@ void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlReleaseSRWLockExclusive( RTL_SRWLOCK *lock )
 {
+    if (fast_release_srw_exclusive( lock ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     srwlock_leave_exclusive( lock, srwlock_unlock_exclusive( (unsigned int *)&lock->Ptr,
                              - SRWLOCK_RES_EXCLUSIVE ) - SRWLOCK_RES_EXCLUSIVE );
 }
@@ -1802,6 +2165,9 @@ void WINAPI RtlReleaseSRWLockExclusive( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlReleaseSRWLockShared( RTL_SRWLOCK *lock )
 {
+    if (fast_release_srw_shared( lock ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     srwlock_leave_shared( lock, srwlock_lock_exclusive( (unsigned int *)&lock->Ptr,
                           - SRWLOCK_RES_SHARED ) - SRWLOCK_RES_SHARED );
 }
@@ -1815,6 +2181,11 @@ void WINAPI RtlReleaseSRWLockShared( RTL_SRWLOCK *lock )
  */
 BOOLEAN WINAPI RtlTryAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 {
+    NTSTATUS ret;
+
+    if ((ret = fast_try_acquire_srw_exclusive( lock )) != STATUS_NOT_IMPLEMENTED)
+        return (ret == STATUS_SUCCESS);
+
     return interlocked_cmpxchg( (int *)&lock->Ptr, SRWLOCK_MASK_IN_EXCLUSIVE |
                                 SRWLOCK_RES_EXCLUSIVE, 0 ) == 0;
 }
@@ -1825,6 +2196,11 @@ BOOLEAN WINAPI RtlTryAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 BOOLEAN WINAPI RtlTryAcquireSRWLockShared( RTL_SRWLOCK *lock )
 {
     unsigned int val, tmp;
+    NTSTATUS ret;
+
+    if ((ret = fast_try_acquire_srw_shared( lock )) != STATUS_NOT_IMPLEMENTED)
+        return (ret == STATUS_SUCCESS);
+
     for (val = *(unsigned int *)&lock->Ptr;; val = tmp)
     {
         if (val & SRWLOCK_MASK_EXCLUSIVE_QUEUE)
@@ -1868,6 +2244,9 @@ void WINAPI RtlInitializeConditionVariable( RTL_CONDITION_VARIABLE *variable )
  */
 void WINAPI RtlWakeConditionVariable( RTL_CONDITION_VARIABLE *variable )
 {
+    if (fast_wake_cv( variable, 1 ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     if (interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
         NtReleaseKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
 }
@@ -1879,11 +2258,29 @@ void WINAPI RtlWakeConditionVariable( RTL_CONDITION_VARIABLE *variable )
  */
 void WINAPI RtlWakeAllConditionVariable( RTL_CONDITION_VARIABLE *variable )
 {
-    int val = interlocked_xchg( (int *)&variable->Ptr, 0 );
+    int val;
+
+    if (fast_wake_cv( variable, INT_MAX ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
+    val = interlocked_xchg( (int *)&variable->Ptr, 0 );
     while (val-- > 0)
         NtReleaseKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
 }
 
+/* wait on the keyed event for a wake-up; the waiter count must have been incremented */
+static NTSTATUS sleep_cv_keyed_event( RTL_CONDITION_VARIABLE *variable, const LARGE_INTEGER *timeout )
+{
+    NTSTATUS status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, timeout );
+
+    if (status != STATUS_SUCCESS)
+    {
+        if (!interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
+            status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
+    }
+    return status;
+}
+
 /***********************************************************************
  *           RtlSleepConditionVariableCS   (NTDLL.@)
  *
@@ -1903,15 +2300,13 @@ NTSTATUS WINAPI RtlSleepConditionVariableCS( RTL_CONDITION_VARIABLE *variable, R
                                              const LARGE_INTEGER *timeout )
 {
     NTSTATUS status;
-    interlocked_xchg_add( (int *)&variable->Ptr, 1 );
+    int val = *(int *)&variable->Ptr;
+
+    if (!use_futexes()) interlocked_xchg_add( (int *)&variable->Ptr, 1 );
     RtlLeaveCriticalSection( crit );
 
-    status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, timeout );
-    if (status != STATUS_SUCCESS)
-    {
-        if (!interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
-            status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
-    }
+    if ((status = fast_sleep_cv( variable, val, timeout )) == STATUS_NOT_IMPLEMENTED)
+        status = sleep_cv_keyed_event( variable, timeout );
 
     RtlEnterCriticalSection( crit );
     return status;
@@ -1940,19 +2335,17 @@ NTSTATUS WINAPI RtlSleepConditionVariableSRW( RTL_CONDITION_VARIABLE *variable,
                                               const LARGE_INTEGER *timeout, ULONG flags )
 {
     NTSTATUS status;
-    interlocked_xchg_add( (int *)&variable->Ptr, 1 );
+    int val = *(int *)&variable->Ptr;
+
+    if (!use_futexes()) interlocked_xchg_add( (int *)&variable->Ptr, 1 );
 
     if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
         RtlReleaseSRWLockShared( lock );
     else
         RtlReleaseSRWLockExclusive( lock );
 
-    status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, timeout );
-    if (status != STATUS_SUCCESS)
-    {
-        if (!interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
-            status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
-    }
+    if ((status = fast_sleep_cv( variable, val, timeout )) == STATUS_NOT_IMPLEMENTED)
+        status = sleep_cv_keyed_event( variable, timeout );
 
     if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
         RtlAcquireSRWLockShared( lock );
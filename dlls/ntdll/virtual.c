@@ -229,10 +229,13 @@ static void set_page_vprot_bits( const void *addr, size_t size, BYTE set, BYTE c
     size_t end = ((size_t)addr + size + page_mask) >> page_shift;
 
 #ifdef _WIN64
-    for ( ; idx < end; idx++)
+    while (idx < end)
     {
         BYTE *ptr = pages_vprot[idx >> pages_vprot_shift] + (idx & pages_vprot_mask);
-        *ptr = (*ptr & ~clear) | set;
+        size_t count = min( end - idx, pages_vprot_mask + 1 - (idx & pages_vprot_mask) );
+
+        idx += count;
+        for ( ; count; count--, ptr++) *ptr = (*ptr & ~clear) | set;
     }
 #else
     for ( ; idx < end; idx++) pages_vprot[idx] = (pages_vprot[idx] & ~clear) | set;
@@ -240,6 +243,55 @@ static void set_page_vprot_bits( const void *addr, size_t size, BYTE set, BYTE c
 }
 
 
+/***********************************************************************
+ *           get_vprot_range_size
+ *
+ * Return the size of the page-aligned range starting at base in which the
+ * masked page protection bytes are all the same as those of the first page,
+ * which are returned in vprot. The bytes are compared a word at a time.
+ */
+static SIZE_T get_vprot_range_size( char *base, SIZE_T size, BYTE mask, BYTE *vprot )
+{
+    static const UINT_PTR word_from_byte = (UINT_PTR)0x0101010101010101;
+    static const size_t index_align_mask = sizeof(UINT_PTR) - 1;
+    size_t curr_idx, start_idx, end_idx, aligned_start_idx;
+    UINT_PTR vprot_word, mask_word;
+    const BYTE *vprot_ptr;
+
+    curr_idx = start_idx = (size_t)base >> page_shift;
+    end_idx = start_idx + (size >> page_shift);
+    aligned_start_idx = min( (start_idx + index_align_mask) & ~index_align_mask, end_idx );
+
+#ifdef _WIN64
+    vprot_ptr = pages_vprot[curr_idx >> pages_vprot_shift] + (curr_idx & pages_vprot_mask);
+#else
+    vprot_ptr = pages_vprot + curr_idx;
+#endif
+    *vprot = *vprot_ptr;
+
+    for ( ; curr_idx < aligned_start_idx; curr_idx++, vprot_ptr++)
+        if ((*vprot ^ *vprot_ptr) & mask) return (curr_idx - start_idx) << page_shift;
+
+    /* the page table blocks are a multiple of the word size, so an aligned word
+     * never crosses a block boundary, even past the end of the range */
+    vprot_word = word_from_byte * *vprot;
+    mask_word = word_from_byte * mask;
+    for ( ; curr_idx < end_idx; curr_idx += sizeof(UINT_PTR), vprot_ptr += sizeof(UINT_PTR))
+    {
+#ifdef _WIN64
+        if (!(curr_idx & pages_vprot_mask)) vprot_ptr = pages_vprot[curr_idx >> pages_vprot_shift];
+#endif
+        if ((vprot_word ^ *(const UINT_PTR *)vprot_ptr) & mask_word)
+        {
+            for ( ; curr_idx < end_idx; curr_idx++, vprot_ptr++)
+                if ((*vprot ^ *vprot_ptr) & mask) break;
+            return (curr_idx - start_idx) << page_shift;
+        }
+    }
+    return size;
+}
+
+
 /***********************************************************************
  *           alloc_pages_vprot
  *
@@ -1211,7 +1263,7 @@ done:
  */
 static SIZE_T get_committed_size( struct file_view *view, void *base, BYTE *vprot )
 {
-    SIZE_T i, start;
+    SIZE_T start;
 
     start = ((char *)base - (char *)view->base) >> page_shift;
     *vprot = get_page_vprot( base );
@@ -1236,9 +1288,7 @@ static SIZE_T get_committed_size( struct file_view *view, void *base, BYTE *vpro
         SERVER_END_REQ;
         return ret;
     }
-    for (i = start + 1; i < view->size >> page_shift; i++)
-        if ((*vprot ^ get_page_vprot( (char *)view->base + (i << page_shift) )) & VPROT_COMMITTED) break;
-    return (i - start) << page_shift;
+    return get_vprot_range_size( base, view->size - (start << page_shift), VPROT_COMMITTED, vprot );
 }
 
 
@@ -2905,7 +2955,6 @@ NTSTATUS WINAPI NtQueryVirtualMemory( HANDLE process, LPCVOID addr,
     else
     {
         BYTE vprot;
-        char *ptr;
         SIZE_T range_size = get_committed_size( view, base, &vprot );
 
         info->State = (vprot & VPROT_COMMITTED) ? MEM_COMMIT : MEM_RESERVE;
@@ -2914,9 +2963,7 @@ NTSTATUS WINAPI NtQueryVirtualMemory( HANDLE process, LPCVOID addr,
         if (view->protect & SEC_IMAGE) info->Type = MEM_IMAGE;
         else if (view->protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT)) info->Type = MEM_MAPPED;
         else info->Type = MEM_PRIVATE;
-        for (ptr = base; ptr < base + range_size; ptr += page_size)
-            if ((get_page_vprot( ptr ) ^ vprot) & ~VPROT_WRITEWATCH) break;
-        info->RegionSize = ptr - base;
+        info->RegionSize = get_vprot_range_size( base, range_size, ~VPROT_WRITEWATCH, &vprot );
     }
     server_leave_uninterrupted_section( &csVirtual, &sigset );
 
@@ -3333,10 +3380,19 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
 
         while (pos < *count && addr < end)
         {
-            if (!(get_page_vprot( addr ) & VPROT_WRITEWATCH)) addresses[pos++] = addr;
-            addr += page_size;
+            BYTE vprot;
+            SIZE_T range_size = get_vprot_range_size( addr, end - addr, VPROT_WRITEWATCH, &vprot );
+
+            if (vprot & VPROT_WRITEWATCH)  /* skip the pages that haven't been written to */
+            {
+                addr += range_size;
+                continue;
+            }
+            for ( ; pos < *count && range_size; range_size -= page_size, addr += page_size)
+                addresses[pos++] = addr;
         }
-        if (flags & WRITE_WATCH_FLAG_RESET) reset_write_watches( base, addr - (char *)base );
+        /* nothing to reset if no page was written to */
+        if ((flags & WRITE_WATCH_FLAG_RESET) && pos) reset_write_watches( base, addr - (char *)base );
         *count = pos;
         *granularity = page_size;
     }
@@ -64,6 +64,9 @@
 #ifdef HAVE_SYS_UIO_H
 # include <sys/uio.h>
 #endif
+#ifdef HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
 #ifdef HAVE_SYS_SOCKET_H
 #include <sys/socket.h>
 #endif
@@ -534,6 +537,7 @@ struct ws2_transmitfile_async
     TRANSMIT_FILE_BUFFERS buffers;
     DWORD                 flags;
     LARGE_INTEGER         offset;
+    BOOL                  use_sendfile;
     struct ws2_async      write;
 };
 
@@ -2414,11 +2418,9 @@ static NTSTATUS WS2_async_recv( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS stat
 
         result = WS2_recv( fd, wsa, convert_flags(wsa->flags) );
         wine_server_release_fd( wsa->hSocket, fd );
+        /* on success, FD_READ is re-enabled by the server when it gets the result */
         if (result >= 0)
-        {
             status = STATUS_SUCCESS;
-            _enable_event( wsa->hSocket, FD_READ, 0, 0 );
-        }
         else
         {
             if (errno == EAGAIN)
@@ -2520,7 +2522,7 @@ static NTSTATUS WS2_async_accept( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS st
         goto finish;
 
     wsa->io.callback = WS2_async_accept_recv;
-    status = register_async( ASYNC_TYPE_READ, wsa->accept_socket, &wsa->io,
+    status = register_async( ASYNC_TYPE_RECV, wsa->accept_socket, &wsa->io,
                              wsa->user_overlapped->hEvent, NULL, NULL, iosb);
 
     if (status != STATUS_PENDING)
@@ -2922,6 +2924,53 @@ static NTSTATUS WS2_ReadFile(HANDLE hFile, PIO_STATUS_BLOCK io_status, char* buf
     return status;
 }
 
+#ifdef HAVE_SYS_SENDFILE_H
+/***********************************************************************
+ *     WS2_transmitfile_sendfile        (INTERNAL)
+ *
+ * Send the file data directly from the file to the socket, without copying
+ * it through a user-space buffer. Returns STATUS_NOT_SUPPORTED if sendfile()
+ * can't be used for this file, STATUS_END_OF_FILE once the file data is sent.
+ */
+static NTSTATUS WS2_transmitfile_sendfile( int fd, struct ws2_transmitfile_async *wsa )
+{
+    IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->write.user_overlapped;
+    size_t count = 0x7ffff000;  /* maximum transfer size of sendfile() on Linux */
+    NTSTATUS status;
+    off_t offset;
+    ssize_t n;
+    int file_fd;
+
+    if ((status = wine_server_handle_to_fd( wsa->file, FILE_READ_DATA, &file_fd, NULL )))
+        return status;
+
+    if (wsa->file_bytes != 0) count = min( count, wsa->file_bytes - wsa->file_read );
+    offset = wsa->offset.QuadPart;
+    do
+    {
+        if (wsa->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+            n = sendfile( fd, file_fd, &offset, count );
+        else
+            n = sendfile( fd, file_fd, NULL, count );
+    } while (n == -1 && errno == EINTR);
+    wine_server_release_fd( wsa->file, file_fd );
+
+    if (n == -1)
+    {
+        if (errno == EAGAIN) return STATUS_PENDING;
+        if ((errno == EINVAL || errno == ENOSYS) && !wsa->file_read) return STATUS_NOT_SUPPORTED;
+        return wsaErrStatus();
+    }
+
+    TRACE( "sent %ld bytes of file %p\n", (long)n, wsa->file );
+    if (wsa->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION) wsa->offset.QuadPart = offset;
+    if (iosb) iosb->Information += n;
+    wsa->file_read += n;
+    if (!n || (wsa->file_bytes != 0 && wsa->file_read >= wsa->file_bytes)) return STATUS_END_OF_FILE;
+    return STATUS_PENDING;
+}
+#endif
+
 /***********************************************************************
  *     WS2_transmitfile_getbuffer       (INTERNAL)
  *
@@ -2945,6 +2994,19 @@ static NTSTATUS WS2_transmitfile_getbuffer( int fd, struct ws2_transmitfile_asyn
     }
 
     /* process the main file */
+#ifdef HAVE_SYS_SENDFILE_H
+    if (wsa->file && wsa->use_sendfile)
+    {
+        NTSTATUS status = WS2_transmitfile_sendfile( fd, wsa );
+
+        if (status == STATUS_NOT_SUPPORTED)
+            wsa->use_sendfile = FALSE;
+        else if (status == STATUS_END_OF_FILE)
+            wsa->file = NULL; /* continue on to the footer */
+        else
+            return status;
+    }
+#endif
     if (wsa->file)
     {
         DWORD bytes_per_send = wsa->bytes_per_send;
@@ -3004,7 +3066,8 @@ static NTSTATUS WS2_transmitfile_base( int fd, struct ws2_transmitfile_async *ws
     NTSTATUS status;
 
     status = WS2_transmitfile_getbuffer( fd, wsa );
-    if (status == STATUS_PENDING)
+    /* nothing to send here if the file data went out through sendfile() */
+    if (status == STATUS_PENDING && wsa->write.first_iovec < wsa->write.n_iovecs)
     {
         IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->write.user_overlapped;
         int n;
@@ -3108,6 +3171,7 @@ static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD
     wsa->bytes_per_send        = bytes_per_send;
     wsa->flags                 = flags;
     wsa->offset.QuadPart       = FILE_USE_FILE_POINTER_POSITION;
+    wsa->use_sendfile          = h != NULL;
     wsa->write.hSocket         = SOCKET2HANDLE(s);
     wsa->write.addr            = NULL;
     wsa->write.addrlen.val     = 0;
@@ -5178,6 +5242,22 @@ int WINAPI WS_recvfrom(SOCKET s, char *buf, INT len, int flags,
         return n;
 }
 
+/* get the per-thread poll array, growing it if needed */
+static struct pollfd *get_poll_fds( struct per_thread_data *ptb, unsigned int count )
+{
+    struct pollfd *fds;
+
+    /* check if the cache can hold all descriptors, if not do the resizing */
+    if (ptb->fd_count < count)
+    {
+        if (!(fds = HeapAlloc(GetProcessHeap(), 0, count * sizeof(fds[0])))) return NULL;
+        HeapFree(GetProcessHeap(), 0, ptb->fd_cache);
+        ptb->fd_cache = fds;
+        ptb->fd_count = count;
+    }
+    return ptb->fd_cache;
+}
+
 /* allocate a poll array for the corresponding fd sets */
 static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set *writefds,
                                        const WS_fd_set *exceptfds, int *count_ptr )
@@ -5196,20 +5276,11 @@ static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set
         return NULL;
     }
 
-    /* check if the cache can hold all descriptors, if not do the resizing */
-    if (ptb->fd_count < count)
+    if (!(fds = get_poll_fds( ptb, count )))
     {
-        if (!(fds = HeapAlloc(GetProcessHeap(), 0, count * sizeof(fds[0]))))
-        {
-            SetLastError( ERROR_NOT_ENOUGH_MEMORY );
-            return NULL;
-        }
-        HeapFree(GetProcessHeap(), 0, ptb->fd_cache);
-        ptb->fd_cache = fds;
-        ptb->fd_count = count;
+        SetLastError( ERROR_NOT_ENOUGH_MEMORY );
+        return NULL;
     }
-    else
-        fds = ptb->fd_cache;
 
     if (readfds)
         for (i = 0; i < readfds->fd_count; i++, j++)
@@ -5439,7 +5510,7 @@ int WINAPI WSAPoll(WSAPOLLFD *wfds, ULONG count, int timeout)
         return SOCKET_ERROR;
     }
 
-    if (!(ufds = HeapAlloc(GetProcessHeap(), 0, count * sizeof(ufds[0]))))
+    if (!(ufds = get_poll_fds( get_per_thread_data(), count )))
     {
         SetLastError(WSAENOBUFS);
         return SOCKET_ERROR;
@@ -5477,8 +5548,6 @@ int WINAPI WSAPoll(WSAPOLLFD *wfds, ULONG count, int timeout)
         else
             wfds[i].revents = WS_POLLNVAL;
     }
-
-    HeapFree(GetProcessHeap(), 0, ufds);
     return ret;
 }
 
@@ -5497,6 +5566,24 @@ static void WS_AddCompletion( SOCKET sock, ULONG_PTR CompletionValue, NTSTATUS C
     SERVER_END_REQ;
 }
 
+/* helper to report an i/o operation that completed immediately: queues the completion
+ * message, re-enables the socket events in mask and signals the event in a single call */
+static void WS_CompleteIo( SOCKET sock, HANDLE event, ULONG_PTR CompletionValue,
+                           NTSTATUS CompletionStatus, ULONG Information, unsigned int mask )
+{
+    SERVER_START_REQ( complete_socket_io )
+    {
+        req->handle      = wine_server_obj_handle( SOCKET2HANDLE(sock) );
+        req->event       = wine_server_obj_handle( event );
+        req->cvalue      = CompletionValue;
+        req->status      = CompletionStatus;
+        req->information = Information;
+        req->mask        = mask;
+        wine_server_call( req );
+    }
+    SERVER_END_REQ;
+}
+
 
 /***********************************************************************
  *		send			(WS2_32.19)
@@ -5636,8 +5723,8 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
         if (lpNumberOfBytesSent) *lpNumberOfBytesSent = n;
         if (!wsa->completion_func)
         {
-            if (cvalue) WS_AddCompletion( s, cvalue, STATUS_SUCCESS, n );
-            if (lpOverlapped->hEvent) SetEvent( lpOverlapped->hEvent );
+            if (cvalue || lpOverlapped->hEvent)
+                WS_CompleteIo( s, lpOverlapped->hEvent, cvalue, STATUS_SUCCESS, n, 0 );
             HeapFree( GetProcessHeap(), 0, wsa );
         }
         else NtQueueApcThread( GetCurrentThread(), (PNTAPCFUNC)ws2_async_apc,
@@ -7967,10 +8054,10 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
                 iosb->Information = 0;
 
                 if (wsa->completion_func)
-                    err = register_async( ASYNC_TYPE_READ, wsa->hSocket, &wsa->io, NULL,
+                    err = register_async( ASYNC_TYPE_RECV, wsa->hSocket, &wsa->io, NULL,
                                           ws2_async_apc, wsa, iosb );
                 else
-                    err = register_async( ASYNC_TYPE_READ, wsa->hSocket, &wsa->io, lpOverlapped->hEvent,
+                    err = register_async( ASYNC_TYPE_RECV, wsa->hSocket, &wsa->io, lpOverlapped->hEvent,
                                           NULL, (void *)cvalue, iosb );
 
                 if (err != STATUS_PENDING) HeapFree( GetProcessHeap(), 0, wsa );
@@ -7982,13 +8069,15 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
             iosb->Information = n;
             if (!wsa->completion_func)
             {
-                if (cvalue) WS_AddCompletion( s, cvalue, STATUS_SUCCESS, n );
-                if (lpOverlapped->hEvent) SetEvent( lpOverlapped->hEvent );
+                WS_CompleteIo( s, lpOverlapped->hEvent, cvalue, STATUS_SUCCESS, n, FD_READ );
                 HeapFree( GetProcessHeap(), 0, wsa );
             }
-            else NtQueueApcThread( GetCurrentThread(), (PNTAPCFUNC)ws2_async_apc,
-                                   (ULONG_PTR)wsa, (ULONG_PTR)iosb, 0 );
-            _enable_event(SOCKET2HANDLE(s), FD_READ, 0, 0);
+            else
+            {
+                NtQueueApcThread( GetCurrentThread(), (PNTAPCFUNC)ws2_async_apc,
+                                  (ULONG_PTR)wsa, (ULONG_PTR)iosb, 0 );
+                _enable_event(SOCKET2HANDLE(s), FD_READ, 0, 0);
+            }
             return 0;
         }
 
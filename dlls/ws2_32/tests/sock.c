@@ -4121,6 +4121,42 @@ todo_wine
     WaitForSingleObject (thread_handle, 1000);
     closesocket(fdRead);
 
+    /* a new unbound socket must not inherit the state of a closed bound one */
+    select_timeout.tv_sec = 0;
+    select_timeout.tv_usec = 0;
+    fdListen = setup_server_socket(&address, &len);
+    FD_ZERO_ALL();
+    FD_SET_ALL(fdListen);
+    ret = select(0, &readfds, &writefds, &exceptfds, &select_timeout);
+    ok(ret == 0, "expected 0, got %d\n", ret);
+    closesocket(fdListen);
+    fdRead = socket(AF_INET, SOCK_STREAM, 0);
+    ok(fdRead != INVALID_SOCKET, "socket failed unexpectedly: %d\n", WSAGetLastError());
+    FD_ZERO_ALL();
+    FD_SET_ALL(fdRead);
+    ret = select(0, &readfds, &writefds, &exceptfds, &select_timeout);
+    ok(ret == 0, "expected 0, got %d\n", ret);
+    ok(!FD_ISSET(fdRead, &readfds), "FD should not be set\n");
+    ok(!FD_ISSET(fdRead, &writefds), "FD should not be set\n");
+    closesocket(fdRead);
+
+    /* same thing when the bound socket is closed with CloseHandle */
+    fdListen = setup_server_socket(&address, &len);
+    FD_ZERO_ALL();
+    FD_SET_ALL(fdListen);
+    ret = select(0, &readfds, &writefds, &exceptfds, &select_timeout);
+    ok(ret == 0, "expected 0, got %d\n", ret);
+    ok(CloseHandle((HANDLE)fdListen), "CloseHandle failed: %u\n", GetLastError());
+    fdRead = socket(AF_INET, SOCK_STREAM, 0);
+    ok(fdRead != INVALID_SOCKET, "socket failed unexpectedly: %d\n", WSAGetLastError());
+    FD_ZERO_ALL();
+    FD_SET_ALL(fdRead);
+    ret = select(0, &readfds, &writefds, &exceptfds, &select_timeout);
+    ok(ret == 0, "expected 0, got %d\n", ret);
+    ok(!FD_ISSET(fdRead, &readfds), "FD should not be set\n");
+    ok(!FD_ISSET(fdRead, &writefds), "FD should not be set\n");
+    closesocket(fdRead);
+
     /* test UDP behavior of unbound sockets */
     select_timeout.tv_sec = 0;
     select_timeout.tv_usec = 250000;
@@ -6871,6 +6907,60 @@ end:
         WSACloseEvent(event);
 }
 
+static void test_WSARecv_shutdown_events(void)
+{
+    WSANETWORKEVENTS events;
+    SOCKET src, dest;
+    WSAOVERLAPPED ov;
+    HANDLE event;
+    WSABUF buf;
+    char data[16];
+    DWORD bytes, flags;
+    BOOL bret;
+    int ret;
+
+    tcp_socketpair(&src, &dest);
+    if (src == INVALID_SOCKET || dest == INVALID_SOCKET)
+    {
+        skip("failed to create sockets\n");
+        return;
+    }
+
+    event = WSACreateEvent();
+    ret = WSAEventSelect(dest, event, FD_READ);
+    ok(!ret, "WSAEventSelect failed, error %d\n", WSAGetLastError());
+
+    memset(&ov, 0, sizeof(ov));
+    ov.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    buf.len = sizeof(data);
+    buf.buf = data;
+    flags = 0;
+    ret = WSARecv(dest, &buf, 1, NULL, &flags, &ov, NULL);
+    ok(ret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING,
+       "WSARecv returned %d, error %d\n", ret, WSAGetLastError());
+
+    ret = send(src, "test", 4, 0);
+    ok(ret == 4, "send returned %d\n", ret);
+    ret = WaitForSingleObject(ov.hEvent, 1000);
+    ok(ret == WAIT_OBJECT_0, "wait failed %d\n", ret);
+    bret = WSAGetOverlappedResult(dest, &ov, &bytes, FALSE, &flags);
+    ok(bret && bytes == 4, "got %d, %u bytes\n", bret, bytes);
+
+    /* completing the shutdown must not look like a completed receive */
+    ret = shutdown(dest, SD_RECEIVE);
+    ok(!ret, "shutdown failed, error %d\n", WSAGetLastError());
+    WaitForSingleObject(event, 200);
+    memset(&events, 0, sizeof(events));
+    ret = WSAEnumNetworkEvents(dest, event, &events);
+    ok(!ret, "WSAEnumNetworkEvents failed, error %d\n", WSAGetLastError());
+    ok(!(events.lNetworkEvents & FD_READ), "got FD_READ\n");
+
+    CloseHandle(ov.hEvent);
+    WSACloseEvent(event);
+    closesocket(src);
+    closesocket(dest);
+}
+
 struct write_watch_thread_args
 {
     int func;
@@ -11488,6 +11578,7 @@ START_TEST( sock )
     test_WSASendMsg();
     test_WSASendTo();
     test_WSARecv();
+    test_WSARecv_shutdown_events();
     test_WSAPoll();
     test_write_watch();
     test_iocp();
@@ -1720,6 +1720,23 @@ struct enable_socket_event_reply
     struct reply_header __header;
 };
 
+
+struct complete_socket_io_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+    obj_handle_t event;
+    char __pad_20[4];
+    apc_param_t  cvalue;
+    apc_param_t  information;
+    unsigned int status;
+    unsigned int mask;
+};
+struct complete_socket_io_reply
+{
+    struct reply_header __header;
+};
+
 struct set_socket_deferred_request
 {
     struct request_header __header;
@@ -3274,6 +3291,7 @@ struct register_async_reply
 #define ASYNC_TYPE_READ  0x01
 #define ASYNC_TYPE_WRITE 0x02
 #define ASYNC_TYPE_WAIT  0x03
+#define ASYNC_TYPE_RECV  0x04
 
 
 
@@ -5341,6 +5359,20 @@ struct set_completion_info_reply
 
 
 
+struct set_fd_completion_mode_request
+{
+    struct request_header __header;
+    obj_handle_t  handle;
+    unsigned int  flags;
+    char __pad_20[4];
+};
+struct set_fd_completion_mode_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct add_fd_completion_request
 {
     struct request_header __header;
@@ -5754,6 +5786,7 @@ enum request
     REQ_get_socket_event,
     REQ_get_socket_info,
     REQ_enable_socket_event,
+    REQ_complete_socket_io,
     REQ_set_socket_deferred,
     REQ_alloc_console,
     REQ_free_console,
@@ -5966,6 +5999,7 @@ enum request
     REQ_remove_completion,
     REQ_query_completion,
     REQ_set_completion_info,
+    REQ_set_fd_completion_mode,
     REQ_add_fd_completion,
     REQ_set_fd_disp_info,
     REQ_set_fd_name_info,
@@ -6054,6 +6088,7 @@ union generic_request
     struct get_socket_event_request get_socket_event_request;
     struct get_socket_info_request get_socket_info_request;
     struct enable_socket_event_request enable_socket_event_request;
+    struct complete_socket_io_request complete_socket_io_request;
     struct set_socket_deferred_request set_socket_deferred_request;
     struct alloc_console_request alloc_console_request;
     struct free_console_request free_console_request;
@@ -6266,6 +6301,7 @@ union generic_request
     struct remove_completion_request remove_completion_request;
     struct query_completion_request query_completion_request;
     struct set_completion_info_request set_completion_info_request;
+    struct set_fd_completion_mode_request set_fd_completion_mode_request;
     struct add_fd_completion_request add_fd_completion_request;
     struct set_fd_disp_info_request set_fd_disp_info_request;
     struct set_fd_name_info_request set_fd_name_info_request;
@@ -6352,6 +6388,7 @@ union generic_reply
     struct get_socket_event_reply get_socket_event_reply;
     struct get_socket_info_reply get_socket_info_reply;
     struct enable_socket_event_reply enable_socket_event_reply;
+    struct complete_socket_io_reply complete_socket_io_reply;
     struct set_socket_deferred_reply set_socket_deferred_reply;
     struct alloc_console_reply alloc_console_reply;
     struct free_console_reply free_console_reply;
@@ -6564,6 +6601,7 @@ union generic_reply
     struct remove_completion_reply remove_completion_reply;
     struct query_completion_reply query_completion_reply;
     struct set_completion_info_reply set_completion_info_reply;
+    struct set_fd_completion_mode_reply set_fd_completion_mode_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
     struct set_fd_disp_info_reply set_fd_disp_info_reply;
     struct set_fd_name_info_reply set_fd_name_info_reply;
@@ -6588,6 +6626,6 @@ union generic_reply
     struct get_esync_apc_fd_reply get_esync_apc_fd_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 557
+#define SERVER_PROTOCOL_VERSION 560
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
@@ -53,6 +53,7 @@ struct async
     int                  direct_result;   /* a flag if we're passing result directly from request instead of APC  */
     struct completion   *completion;      /* completion associated with fd */
     apc_param_t          comp_key;        /* completion key associated with fd */
+    async_completion_callback completion_callback; /* callback to the fd once the result is known */
 };
 
 static void async_dump( struct object *obj, int verbose );
@@ -202,6 +203,12 @@ void free_async_queue( struct async_queue *queue )
     }
 }
 
+/* set a function to call on the fd when the async result is reported */
+void async_set_completion_callback( struct async *async, async_completion_callback func )
+{
+    async->completion_callback = func;
+}
+
 void queue_async( struct async_queue *queue, struct async *async )
 {
     /* fd will be set to NULL in free_async_queue when fd is destroyed */
@@ -240,6 +247,7 @@ struct async *create_async( struct fd *fd, struct thread *thread, const async_da
     async->wait_handle   = 0;
     async->direct_result = 0;
     async->completion    = fd_get_completion( fd, &async->comp_key );
+    async->completion_callback = NULL;
 
     if (iosb) async->iosb = (struct iosb *)grab_object( iosb );
     else async->iosb = NULL;
@@ -367,6 +375,9 @@ void async_set_result( struct object *obj, unsigned int status, apc_param_t tota
         async->status = status;
         if (status == STATUS_MORE_PROCESSING_REQUIRED) return;  /* don't report the completion */
 
+        /* fd is cleared by free_async_queue once the fd is gone */
+        if (async->completion_callback && async->fd) async->completion_callback( async->fd, status );
+
         if (async->data.apc)
         {
             apc_call_t data;
@@ -195,6 +195,7 @@ struct fd
     struct async_queue   wait_q;      /* other async waiters of this fd */
     struct completion   *completion;  /* completion object attached to this fd */
     apc_param_t          comp_key;    /* completion key to set in completion events */
+    unsigned int         comp_flags;  /* completion notification flags */
     int                  esync_fd;    /* esync file descriptor */
 };
 
@@ -364,13 +365,18 @@ static file_pos_t max_unix_offset = OFF_T_MAX;
 
 struct timeout_user
 {
-    struct list           entry;      /* entry in sorted timeout list */
+    struct list           entry;      /* entry in expired list */
+    int                   index;      /* index in the timeouts heap, -1 once expired */
     timeout_t             when;       /* timeout expiry (absolute time) */
+    unsigned int          seq;        /* insertion order, to expire equal timeouts in order */
     timeout_callback      callback;   /* callback function */
     void                 *private;    /* callback private data */
 };
 
-static struct list timeout_list = LIST_INIT(timeout_list);   /* sorted timeouts list */
+static struct timeout_user **timeout_heap;  /* binary heap of pending timeouts, earliest first */
+static unsigned int timeout_count;          /* number of pending timeouts */
+static unsigned int timeout_size;           /* allocated size of the heap array */
+static unsigned int timeout_seq;            /* sequence number of the last added timeout */
 timeout_t current_time;
 
 static inline void set_current_time(void)
@@ -381,32 +387,97 @@ static inline void set_current_time(void)
     current_time = (timeout_t)now.tv_sec * TICKS_PER_SEC + now.tv_usec * 10 + ticks_1601_to_1970;
 }
 
+static inline void set_timeout_heap_entry( unsigned int index, struct timeout_user *user )
+{
+    timeout_heap[index] = user;
+    user->index = index;
+}
+
+/* check if a timeout expires before another one; equal timeouts expire in the order they were added */
+static inline int timeout_before( const struct timeout_user *a, const struct timeout_user *b )
+{
+    if (a->when != b->when) return a->when < b->when;
+    return (int)(a->seq - b->seq) < 0;
+}
+
+/* move a timeout up the heap until its parent expires before it */
+static void timeout_heap_up( unsigned int index, struct timeout_user *user )
+{
+    while (index)
+    {
+        unsigned int parent = (index - 1) / 2;
+        if (!timeout_before( user, timeout_heap[parent] )) break;
+        set_timeout_heap_entry( index, timeout_heap[parent] );
+        index = parent;
+    }
+    set_timeout_heap_entry( index, user );
+}
+
+/* move a timeout down the heap until its children expire after it */
+static void timeout_heap_down( unsigned int index, struct timeout_user *user )
+{
+    for (;;)
+    {
+        unsigned int child = 2 * index + 1;
+
+        if (child >= timeout_count) break;
+        if (child + 1 < timeout_count && timeout_before( timeout_heap[child + 1], timeout_heap[child] ))
+            child++;
+        if (!timeout_before( timeout_heap[child], user )) break;
+        set_timeout_heap_entry( index, timeout_heap[child] );
+        index = child;
+    }
+    set_timeout_heap_entry( index, user );
+}
+
+/* remove a timeout from the heap */
+static void timeout_heap_remove( struct timeout_user *user )
+{
+    unsigned int index = user->index;
+    struct timeout_user *last = timeout_heap[--timeout_count];
+
+    user->index = -1;
+    if (last == user) return;
+    if (index && timeout_before( last, timeout_heap[(index - 1) / 2] ))
+        timeout_heap_up( index, last );
+    else
+        timeout_heap_down( index, last );
+}
+
 /* add a timeout user */
 struct timeout_user *add_timeout_user( timeout_t when, timeout_callback func, void *private )
 {
     struct timeout_user *user;
-    struct list *ptr;
+
+    if (timeout_count == timeout_size)
+    {
+        unsigned int new_size = timeout_size ? timeout_size * 2 : 64;
+        struct timeout_user **new_heap;
+
+        if (!(new_heap = realloc( timeout_heap, new_size * sizeof(*new_heap) )))
+        {
+            set_error( STATUS_NO_MEMORY );
+            return NULL;
+        }
+        timeout_heap = new_heap;
+        timeout_size = new_size;
+    }
 
     if (!(user = mem_alloc( sizeof(*user) ))) return NULL;
     user->when     = (when > 0) ? when : current_time - when;
+    user->seq      = ++timeout_seq;
     user->callback = func;
     user->private  = private;
 
-    /* Now insert it in the linked list */
-
-    LIST_FOR_EACH( ptr, &timeout_list )
-    {
-        struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-        if (timeout->when >= user->when) break;
-    }
-    list_add_before( ptr, &user->entry );
+    timeout_heap_up( timeout_count++, user );
     return user;
 }
 
 /* remove a timeout user */
 void remove_timeout_user( struct timeout_user *user )
 {
-    list_remove( &user->entry );
+    if (user->index == -1) list_remove( &user->entry );  /* expired but not called yet */
+    else timeout_heap_remove( user );
     free( user );
 }
 
@@ -852,23 +923,19 @@ static void remove_poll_user( struct fd *fd, int user )
 /* process pending timeouts and return the time until the next timeout, in milliseconds */
 static int get_next_timeout(void)
 {
-    if (!list_empty( &timeout_list ))
+    if (timeout_count)
     {
         struct list expired_list, *ptr;
 
-        /* first remove all expired timers from the list */
+        /* first remove all expired timers from the heap */
 
         list_init( &expired_list );
-        while ((ptr = list_head( &timeout_list )) != NULL)
+        while (timeout_count && timeout_heap[0]->when <= current_time)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
+            struct timeout_user *timeout = timeout_heap[0];
 
-            if (timeout->when <= current_time)
-            {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
-            }
-            else break;
+            timeout_heap_remove( timeout );
+            list_add_tail( &expired_list, &timeout->entry );
         }
 
         /* now call the callback for all the removed timers */
@@ -881,10 +948,9 @@ static int get_next_timeout(void)
             free( timeout );
         }
 
-        if ((ptr = list_head( &timeout_list )) != NULL)
+        if (timeout_count)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            int diff = (timeout->when - current_time + 9999) / 10000;
+            int diff = (timeout_heap[0]->when - current_time + 9999) / 10000;
             if (diff < 0) diff = 0;
             return diff;
         }
@@ -1613,6 +1679,7 @@ static struct fd *alloc_fd_object(void)
     fd->fs_locks   = 1;
     fd->poll_index = -1;
     fd->completion = NULL;
+    fd->comp_flags = 0;
     fd->esync_fd   = -1;
     init_async_queue( &fd->read_q );
     init_async_queue( &fd->write_q );
@@ -1649,6 +1716,7 @@ struct fd *alloc_pseudo_fd( const struct fd_ops *fd_user_ops, struct object *use
     fd->fs_locks   = 0;
     fd->poll_index = -1;
     fd->completion = NULL;
+    fd->comp_flags = 0;
     fd->no_fd_status = STATUS_BAD_DEVICE_TYPE;
     fd->esync_fd   = -1;
     init_async_queue( &fd->read_q );
@@ -2400,6 +2468,13 @@ void fd_copy_completion( struct fd *src, struct fd *dst )
     dst->completion = fd_get_completion( src, &dst->comp_key );
 }
 
+/* queue a completion packet for an I/O operation on the fd, if it has a completion port */
+void fd_add_completion( struct fd *fd, apc_param_t cvalue, unsigned int status, apc_param_t information )
+{
+    if (fd->completion && (status || !(fd->comp_flags & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS)))
+        add_completion( fd->completion, fd->comp_key, cvalue, status, information );
+}
+
 /* flush a file buffers */
 DECL_HANDLER(flush)
 {
@@ -2561,6 +2636,7 @@ DECL_HANDLER(register_async)
     switch(req->type)
     {
     case ASYNC_TYPE_READ:
+    case ASYNC_TYPE_RECV:
         access = FILE_READ_DATA;
         break;
     case ASYNC_TYPE_WRITE:
@@ -2599,14 +2675,30 @@ DECL_HANDLER(set_completion_info)
     }
 }
 
+/* set the completion notification modes of a fd */
+DECL_HANDLER(set_fd_completion_mode)
+{
+    struct fd *fd = get_handle_fd_obj( current->process, req->handle, 0 );
+
+    if (fd)
+    {
+        if (!(fd->options & (FILE_SYNCHRONOUS_IO_ALERT | FILE_SYNCHRONOUS_IO_NONALERT)) ||
+            !(req->flags & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS))
+            fd->comp_flags |= req->flags;  /* modes can't be cleared once set */
+        else
+            set_error( STATUS_INVALID_PARAMETER );
+        release_object( fd );
+    }
+}
+
 /* push new completion msg into a completion queue attached to the fd */
+/* this is only used for I/O that completed synchronously in the client */
 DECL_HANDLER(add_fd_completion)
 {
     struct fd *fd = get_handle_fd_obj( current->process, req->handle, 0 );
     if (fd)
     {
-        if (fd->completion)
-            add_completion( fd->completion, fd->comp_key, req->cvalue, req->status, req->information );
+        fd_add_completion( fd, req->cvalue, req->status, req->information );
         release_object( fd );
     }
 }
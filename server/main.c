@@ -42,6 +42,7 @@
 /* command-line options */
 int debug_level = 0;
 int foreground = 0;
+static int profile = 0;
 timeout_t master_socket_timeout = 0; /* master socket timeout, default is 3 seconds */
 const char *server_argv0;
 
@@ -56,6 +57,7 @@ static void usage( FILE *fh )
     fprintf(fh, "   -h,    --help            display this help message\n");
     fprintf(fh, "   -k[n], --kill[=n]        kill the current wineserver, optionally with signal n\n");
     fprintf(fh, "   -p[n], --persistent[=n]  make server persistent, optionally for n seconds\n");
+    fprintf(fh, "   -P,    --profile         collect request statistics, dumped on SIGUSR1 and at exit\n");
     fprintf(fh, "   -v,    --version         display version information and exit\n");
     fprintf(fh, "   -w,    --wait            wait until the current wineserver terminates\n");
     fprintf(fh, "\n");
@@ -72,6 +74,7 @@ static void parse_args( int argc, char *argv[] )
         {"help",        0, NULL, 'h'},
         {"kill",        2, NULL, 'k'},
         {"persistent",  2, NULL, 'p'},
+        {"profile",     0, NULL, 'P'},
         {"version",     0, NULL, 'v'},
         {"wait",        0, NULL, 'w'},
         { NULL,         0, NULL, 0}
@@ -79,7 +82,7 @@ static void parse_args( int argc, char *argv[] )
 
     server_argv0 = argv[0];
 
-    while ((optc = getopt_long( argc, argv, "d::fhk::p::vw", long_options, NULL )) != -1)
+    while ((optc = getopt_long( argc, argv, "d::fhk::p::Pvw", long_options, NULL )) != -1)
     {
         switch(optc)
         {
@@ -108,6 +111,9 @@ static void parse_args( int argc, char *argv[] )
                 else
                     master_socket_timeout = TIMEOUT_INFINITE;
                 break;
+            case 'P':
+                profile = 1;
+                break;
             case 'v':
                 fprintf( stderr, "%s\n", wine_get_build_id());
                 exit(0);
@@ -147,6 +153,7 @@ int main( int argc, char *argv[] )
 
     if (debug_level) fprintf( stderr, "wineserver: starting (pid=%ld)\n", (long) getpid() );
     init_signals();
+    if (profile) init_request_profile();
     init_directories();
     init_registry();
     main_loop();
@@ -71,6 +71,8 @@ struct pipe_end
     process_id_t         server_pid; /* process that created the server */
     data_size_t          buffer_size;/* size of buffered data that doesn't block caller */
     struct list          message_queue;
+    data_size_t          queued;     /* size of unread data in the message queue */
+    unsigned int         pending_writes; /* number of queued messages with a pending write */
     struct async_queue   read_q;     /* read queue */
     struct async_queue   write_q;    /* write queue */
 };
@@ -367,15 +369,17 @@ static struct pipe_message *queue_message( struct pipe_end *pipe_end, struct ios
     message->async = NULL;
     message->read_pos = 0;
     list_add_tail( &pipe_end->message_queue, &message->entry );
+    pipe_end->queued += iosb->in_size;
     return message;
 }
 
-static void wake_message( struct pipe_message *message )
+static void wake_message( struct pipe_end *pipe_end, struct pipe_message *message )
 {
     struct async *async = message->async;
 
     message->async = NULL;
     if (!async) return;
+    pipe_end->pending_writes--;
 
     message->iosb->status = STATUS_SUCCESS;
     message->iosb->result = message->iosb->in_size;
@@ -383,10 +387,12 @@ static void wake_message( struct pipe_message *message )
     release_object( async );
 }
 
-static void free_message( struct pipe_message *message )
+static void free_message( struct pipe_end *pipe_end, struct pipe_message *message )
 {
+    pipe_end->queued -= message->iosb->in_size - message->read_pos;
+    if (message->async) pipe_end->pending_writes--;
     list_remove( &message->entry );
-    if (message->iosb) release_object( message->iosb );
+    release_object( message->iosb );
     free( message );
 }
 
@@ -403,7 +409,7 @@ static void pipe_end_disconnect( struct pipe_end *pipe_end, unsigned int status
     LIST_FOR_EACH_ENTRY_SAFE( message, next, &pipe_end->message_queue, struct pipe_message, entry )
     {
         async = message->async;
-        if (async || status == STATUS_PIPE_DISCONNECTED) free_message( message );
+        if (async || status == STATUS_PIPE_DISCONNECTED) free_message( pipe_end, message );
         if (!async) continue;
         async_terminate( async, status );
         release_object( async );
@@ -425,7 +431,7 @@ static void pipe_end_destroy( struct pipe_end *pipe_end )
     {
         message = LIST_ENTRY( list_head(&pipe_end->message_queue), struct pipe_message, entry );
         assert( !message->async );
-        free_message( message );
+        free_message( pipe_end, message );
     }
 
     free_async_queue( &pipe_end->read_q );
@@ -700,8 +706,8 @@ static void message_queue_read( struct pipe_end *pipe_end, struct iosb *iosb )
     {
         iosb->out_data = message->iosb->in_data;
         message->iosb->in_data = NULL;
-        wake_message( message );
-        free_message( message );
+        wake_message( pipe_end, message );
+        free_message( pipe_end, message );
     }
     else
     {
@@ -722,10 +728,11 @@ static void message_queue_read( struct pipe_end *pipe_end, struct iosb *iosb )
             if (writing) memcpy( buf + write_pos, (const char *)message->iosb->in_data + message->read_pos, writing );
             write_pos += writing;
             message->read_pos += writing;
+            pipe_end->queued -= writing;
             if (message->read_pos == message->iosb->in_size)
             {
-                wake_message(message);
-                free_message(message);
+                wake_message( pipe_end, message );
+                free_message( pipe_end, message );
             }
         } while (write_pos < iosb->out_size);
     }
@@ -767,27 +774,44 @@ static void reselect_read_queue( struct pipe_end *pipe_end )
 
 static void reselect_write_queue( struct pipe_end *pipe_end )
 {
-    struct pipe_message *message, *next;
+    struct pipe_message *message;
     struct pipe_end *reader = pipe_end->connection;
-    data_size_t avail = 0;
+    struct list *ptr, *next;
+    unsigned int pending;
+    data_size_t avail;
 
     if (!reader) return;
 
+    /* all the messages before the first pending write have already been woken up, so
+     * start from there instead of walking the whole queue; find it from the tail */
+    avail = reader->queued;
+    pending = reader->pending_writes;
+    ptr = &reader->message_queue;
+    while (pending && (ptr = list_prev( &reader->message_queue, ptr )))
+    {
+        message = LIST_ENTRY( ptr, struct pipe_message, entry );
+        avail -= message->iosb->in_size - message->read_pos;
+        if (message->async) pending--;
+    }
+    if (!reader->pending_writes) ptr = NULL;
+
     ignore_reselect = 1;
 
-    LIST_FOR_EACH_ENTRY_SAFE( message, next, &reader->message_queue, struct pipe_message, entry )
+    for ( ; ptr; ptr = next)
     {
+        next = list_next( &reader->message_queue, ptr );
+        message = LIST_ENTRY( ptr, struct pipe_message, entry );
         if (message->async && message->iosb->status != STATUS_PENDING)
         {
-            release_object( message->async );
-            message->async = NULL;
-            free_message( message );
+            struct async *async = message->async;
+            free_message( reader, message );
+            release_object( async );
         }
         else
         {
             avail += message->iosb->in_size - message->read_pos;
             if (message->async && (avail <= reader->buffer_size || !message->iosb->in_size))
-                wake_message( message );
+                wake_message( reader, message );
         }
     }
 
@@ -831,6 +855,7 @@ static int pipe_end_write( struct fd *fd, struct async *async, file_pos_t pos )
     if (!message) return 0;
 
     message->async = (struct async *)grab_object( async );
+    pipe_end->connection->pending_writes++;
     queue_async( &pipe_end->write_q, async );
     reselect_write_queue( pipe_end );
     set_error( STATUS_PENDING );
@@ -859,7 +884,7 @@ static int pipe_end_peek( struct pipe_end *pipe_end )
     unsigned reply_size = get_reply_max_size();
     FILE_PIPE_PEEK_BUFFER *buffer;
     struct pipe_message *message;
-    data_size_t avail = 0;
+    data_size_t avail;
     data_size_t message_length = 0;
 
     if (reply_size < offsetof( FILE_PIPE_PEEK_BUFFER, Data ))
@@ -875,8 +900,7 @@ static int pipe_end_peek( struct pipe_end *pipe_end )
         return 0;
     }
 
-    LIST_FOR_EACH_ENTRY( message, &pipe_end->message_queue, struct pipe_message, entry )
-        avail += message->iosb->in_size - message->read_pos;
+    avail = pipe_end->queued;
     reply_size = min( reply_size, avail );
 
     if (avail && (pipe_end->flags & NAMED_PIPE_MESSAGE_STREAM_WRITE))
@@ -1089,6 +1113,8 @@ static void init_pipe_end( struct pipe_end *pipe_end, unsigned int pipe_flags, d
     init_async_queue( &pipe_end->read_q );
     init_async_queue( &pipe_end->write_q );
     list_init( &pipe_end->message_queue );
+    pipe_end->queued = 0;
+    pipe_end->pending_writes = 0;
 }
 
 static struct pipe_server *create_pipe_server( struct named_pipe *pipe, unsigned int options,
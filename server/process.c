@@ -539,6 +539,7 @@ struct thread *create_process( int fd, struct thread *parent_thread, int inherit
     process->rawinput_mouse  = NULL;
     process->rawinput_kbd    = NULL;
     process->esync_fd        = -1;
+    process->req_profile     = NULL;
     list_init( &process->thread_list );
     list_init( &process->locks );
     list_init( &process->asyncs );
@@ -650,6 +651,7 @@ static void process_destroy( struct object *obj )
     if (process->id) free_ptid( process->id );
     if (process->token) release_object( process->token );
     free( process->dir_cache );
+    free( process->req_profile );
 
     if (do_esync())
         close( process->esync_fd );
@@ -858,6 +860,7 @@ static void process_killed( struct process *process )
 
     assert( list_empty( &process->thread_list ));
     process->end_time = current_time;
+    dump_process_request_profile( process );
     if (!process->is_system) close_process_desktop( process );
     process->winstation = 0;
     process->desktop = 0;
@@ -27,6 +27,7 @@ struct atom_table;
 struct handle_table;
 struct startup_info;
 struct job;
+struct process_request_profile;
 
 /* process startup state */
 enum startup_state { STARTUP_IN_PROGRESS, STARTUP_DONE, STARTUP_ABORTED };
@@ -96,6 +97,7 @@ struct process
     const struct rawinput_device *rawinput_mouse; /* rawinput mouse device, if any */
     const struct rawinput_device *rawinput_kbd;   /* rawinput keyboard device, if any */
     int                  esync_fd;        /* esync file descriptor (signaled on exit) */
+    struct process_request_profile *req_profile; /* per-request statistics (when profiling) */
 };
 
 struct process_snapshot
@@ -27,6 +27,7 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -72,6 +73,10 @@ struct key
     int               last_subkey; /* last in use subkey */
     int               nb_subkeys;  /* count of allocated subkeys */
     struct key      **subkeys;     /* subkeys array */
+    struct key      **subkey_hash; /* hash table of subkeys, only for keys with many subkeys */
+    unsigned int      hash_size;   /* size of the subkey hash table */
+    struct key       *hash_next;   /* next key in the parent hash table bucket */
+    unsigned int      hash;        /* hash of the key name */
     int               last_value;  /* last in use value */
     int               nb_values;   /* count of allocated values in array */
     struct key_value *values;      /* values array */
@@ -100,6 +105,7 @@ struct key_value
 
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
+#define MIN_SUBKEY_HASH  64  /* min. number of subkeys to create a hash table */
 
 #define MAX_NAME_LEN  256    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
@@ -129,7 +135,10 @@ struct save_branch_info
 
 #define MAX_SAVE_BRANCH_INFO 3
 static int save_branch_count;
+static char file_buffer[65536];  /* stdio buffer for loading and saving registry files */
 static struct save_branch_info save_branch_info[MAX_SAVE_BRANCH_INFO];
+static int save_pipe = -1;               /* pipe to read the result of a background save */
+static unsigned int save_pending;        /* mask of branches being saved in the background */
 
 
 /* information about a file being loaded */
@@ -205,6 +214,9 @@ static void dump_path( const struct key *key, const struct key *base, FILE *f )
 /* dump a value to a text file */
 static void dump_value( const struct key_value *value, FILE *f )
 {
+    static const char hex[16] = "0123456789abcdef";
+    char buffer[256];
+    char *pos = buffer;
     unsigned int i, dw;
     int count;
 
@@ -242,18 +254,29 @@ static void dump_value( const struct key_value *value, FILE *f )
     else count += fprintf( f, "hex(%x):", value->type );
     for (i = 0; i < value->len; i++)
     {
-        count += fprintf( f, "%02x", *((unsigned char *)value->data + i) );
+        unsigned char ch = ((unsigned char *)value->data)[i];
+
+        if (pos > buffer + sizeof(buffer) - 8)
+        {
+            fwrite( buffer, pos - buffer, 1, f );
+            pos = buffer;
+        }
+        *pos++ = hex[ch >> 4];
+        *pos++ = hex[ch & 0x0f];
+        count += 2;
         if (i < value->len-1)
         {
-            fputc( ',', f );
+            *pos++ = ',';
             if (++count > 76)
             {
-                fprintf( f, "\\\n  " );
+                memcpy( pos, "\\\n  ", 4 );
+                pos += 4;
                 count = 2;
             }
         }
     }
-    fputc( '\n', f );
+    *pos++ = '\n';
+    fwrite( buffer, pos - buffer, 1, f );
 }
 
 /* save a registry and all its subkeys to a text file */
@@ -425,6 +448,7 @@ static void key_destroy( struct object *obj )
         release_object( key->subkeys[i] );
     }
     free( key->subkeys );
+    free( key->subkey_hash );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -474,6 +498,15 @@ static struct unicode_str *get_path_token( const struct unicode_str *path, struc
     return token;
 }
 
+/* compute the case-insensitive hash of a key name */
+static unsigned int hash_key_name( const struct unicode_str *name )
+{
+    unsigned int i, hash = 0;
+
+    for (i = 0; i < name->len / sizeof(WCHAR); i++) hash = hash * 65599 + tolowerW( name->str[i] );
+    return hash;
+}
+
 /* allocate a key object */
 static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
 {
@@ -488,6 +521,10 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
         key->last_subkey = -1;
         key->nb_subkeys  = 0;
         key->subkeys     = NULL;
+        key->subkey_hash = NULL;
+        key->hash_size   = 0;
+        key->hash_next   = NULL;
+        key->hash        = hash_key_name( name );
         key->nb_values   = 0;
         key->last_value  = -1;
         key->values      = NULL;
@@ -577,12 +614,52 @@ static int grow_subkeys( struct key *key )
     return 1;
 }
 
+/* add a subkey to the hash table of its parent */
+static inline void hash_subkey( struct key *parent, struct key *key )
+{
+    struct key **bucket = &parent->subkey_hash[key->hash & (parent->hash_size - 1)];
+
+    key->hash_next = *bucket;
+    *bucket = key;
+}
+
+/* remove a subkey from the hash table of its parent */
+static void unhash_subkey( struct key *parent, struct key *key )
+{
+    struct key **ptr = &parent->subkey_hash[key->hash & (parent->hash_size - 1)];
+
+    while (*ptr != key) ptr = &(*ptr)->hash_next;
+    *ptr = key->hash_next;
+    key->hash_next = NULL;
+}
+
+/* (re)build the subkey hash table once a key has enough subkeys; failure isn't fatal */
+static void update_subkey_hash( struct key *key )
+{
+    struct key **new_hash;
+    unsigned int size;
+    int i;
+
+    if (key->last_subkey + 1 < MIN_SUBKEY_HASH) return;
+    if (key->last_subkey + 1 <= key->hash_size) return;
+
+    size = key->hash_size ? key->hash_size * 2 : 4 * MIN_SUBKEY_HASH;
+    while (size < key->last_subkey + 1) size *= 2;
+    new_hash = calloc( size, sizeof(*new_hash) );
+    free( key->subkey_hash );
+    key->subkey_hash = NULL;
+    key->hash_size   = 0;
+    if (!new_hash) return;
+    key->subkey_hash = new_hash;
+    key->hash_size   = size;
+    for (i = 0; i <= key->last_subkey; i++) hash_subkey( key, key->subkeys[i] );
+}
+
 /* allocate a subkey for a given key, and return its index */
 static struct key *alloc_subkey( struct key *parent, const struct unicode_str *name,
                                  int index, timeout_t modif )
 {
     struct key *key;
-    int i;
 
     if (name->len > MAX_NAME_LEN * sizeof(WCHAR))
     {
@@ -597,9 +674,11 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
     if ((key = alloc_key( name, modif )) != NULL)
     {
         key->parent = parent;
-        for (i = ++parent->last_subkey; i > index; i--)
-            parent->subkeys[i] = parent->subkeys[i-1];
+        memmove( parent->subkeys + index + 1, parent->subkeys + index,
+                 (++parent->last_subkey - index) * sizeof(*parent->subkeys) );
         parent->subkeys[index] = key;
+        if (parent->hash_size >= parent->last_subkey + 1) hash_subkey( parent, key );
+        else update_subkey_hash( parent );
         if (is_wow6432node( key->name, key->namelen ) && !is_wow6432node( parent->name, parent->namelen ))
             parent->flags |= KEY_WOW64;
     }
@@ -610,14 +689,16 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
 static void free_subkey( struct key *parent, int index )
 {
     struct key *key;
-    int i, nb_subkeys;
+    int nb_subkeys;
 
     assert( index >= 0 );
     assert( index <= parent->last_subkey );
 
     key = parent->subkeys[index];
-    for (i = index; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
+    memmove( parent->subkeys + index, parent->subkeys + index + 1,
+             (parent->last_subkey - index) * sizeof(*parent->subkeys) );
     parent->last_subkey--;
+    if (parent->subkey_hash) unhash_subkey( parent, key );
     key->flags |= KEY_DELETED;
     key->parent = NULL;
     if (is_wow6432node( key->name, key->namelen )) parent->flags &= ~KEY_WOW64;
@@ -636,8 +717,8 @@ static void free_subkey( struct key *parent, int index )
     }
 }
 
-/* find the named child of a given key and return its index */
-static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
+/* find the index of the named child of a given key, or where it should be inserted */
+static struct key *find_subkey_index( const struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
@@ -662,6 +743,24 @@ static struct key *find_subkey( const struct key *key, const struct unicode_str
     return NULL;
 }
 
+/* find the named child of a given key */
+/* if it doesn't exist, index is set to where it should be inserted */
+static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
+{
+    if (key->subkey_hash)
+    {
+        unsigned int hash = hash_key_name( name );
+        struct key *subkey;
+
+        for (subkey = key->subkey_hash[hash & (key->hash_size - 1)]; subkey; subkey = subkey->hash_next)
+        {
+            if (subkey->hash != hash || subkey->namelen != name->len) continue;
+            if (!memicmpW( subkey->name, name->str, name->len / sizeof(WCHAR) )) return subkey;
+        }
+    }
+    return find_subkey_index( key, name, index );
+}
+
 /* return the wow64 variant of the key, or the key itself if none */
 static struct key *find_wow64_subkey( struct key *key, const struct unicode_str *name )
 {
@@ -988,6 +1087,7 @@ static int delete_key( struct key *key, int recurse )
 {
     int index;
     struct key *parent = key->parent;
+    struct unicode_str name;
 
     /* must find parent and index */
     if (key == root_key)
@@ -1001,9 +1101,10 @@ static int delete_key( struct key *key, int recurse )
         if (0 > delete_key(key->subkeys[key->last_subkey], 1))
             return -1;
 
-    for (index = 0; index <= parent->last_subkey; index++)
-        if (parent->subkeys[index] == key) break;
-    assert( index <= parent->last_subkey );
+    name.str = key->name;
+    name.len = key->namelen;
+    find_subkey_index( parent, &name, &index );
+    assert( parent->subkeys[index] == key );
 
     /* we can only delete a key that has no subkeys */
     if (key->last_subkey >= 0)
@@ -1074,7 +1175,6 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
 {
     struct key_value *value;
     WCHAR *new_name = NULL;
-    int i;
 
     if (name->len > MAX_VALUE_LEN * sizeof(WCHAR))
     {
@@ -1086,7 +1186,8 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
         if (!grow_values( key )) return NULL;
     }
     if (name->len && !(new_name = memdup( name->str, name->len ))) return NULL;
-    for (i = ++key->last_value; i > index; i--) key->values[i] = key->values[i - 1];
+    memmove( key->values + index + 1, key->values + index,
+             (++key->last_value - index) * sizeof(*key->values) );
     value = &key->values[index];
     value->name    = new_name;
     value->namelen = name->len;
@@ -1218,7 +1319,7 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
 static void delete_value( struct key *key, const struct unicode_str *name )
 {
     struct key_value *value;
-    int i, index, nb_values;
+    int index, nb_values;
 
     if (!(value = find_value( key, name, &index )))
     {
@@ -1228,7 +1329,8 @@ static void delete_value( struct key *key, const struct unicode_str *name )
     if (debug_level > 1) dump_operation( key, value, "Delete" );
     free( value->name );
     free( value->data );
-    for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
+    memmove( key->values + index, key->values + index + 1,
+             (key->last_value - index) * sizeof(*key->values) );
     key->last_value--;
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
 
@@ -1470,20 +1572,33 @@ static int load_key_option( struct key *key, const char *buffer, struct file_loa
     return 1;
 }
 
+/* convert a hex digit to its value, or -1 if invalid */
+static inline int hex_digit_value( char ch )
+{
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
 /* parse a comma-separated list of hex digits */
 static int parse_hex( unsigned char *dest, data_size_t *len, const char *buffer )
 {
     const char *p = buffer;
     data_size_t count = 0;
-    char *end;
+    unsigned int val;
+    int digit;
 
-    while (isxdigit(*p))
+    while ((digit = hex_digit_value( *p )) != -1)
     {
-        unsigned int val = strtoul( p, &end, 16 );
-        if (end == p || val > 0xff) return -1;
+        val = 0;
+        do
+        {
+            val = val * 16 + digit;
+            if (val > 0xff) return -1;
+        } while ((digit = hex_digit_value( *++p )) != -1);
         if (count++ >= *len) return -1;  /* dest buffer overflow */
         *dest++ = val;
-        p = end;
         while (isspace(*p)) p++;
         if (*p == ',') p++;
         while (isspace(*p)) p++;
@@ -1633,8 +1748,8 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
 
     info.filename = filename;
     info.file   = f;
-    info.len    = 4;
-    info.tmplen = 4;
+    info.len    = 256;
+    info.tmplen = 256;
     info.line   = 0;
     if (!(info.buffer = mem_alloc( info.len ))) return;
     if (!(info.tmp = mem_alloc( info.tmplen )))
@@ -1642,6 +1757,7 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
         free( info.buffer );
         return;
     }
+    setvbuf( f, file_buffer, _IOFBF, sizeof(file_buffer) );
 
     if ((read_next_line( &info ) != 1) ||
         strcmp( info.buffer, "WINE REGISTRY Version 2" ))
@@ -1874,6 +1990,7 @@ void init_registry(void)
 /* save a registry branch to a file */
 static void save_all_subkeys( struct key *key, FILE *f )
 {
+    setvbuf( f, file_buffer, _IOFBF, sizeof(file_buffer) );
     fprintf( f, "WINE REGISTRY Version 2\n" );
     fprintf( f, ";; All keys relative to " );
     dump_path( key, NULL, f );
@@ -1991,16 +2108,140 @@ done:
     return ret;
 }
 
+#ifdef USE_PTRACE
+
+/* collect the result of a background save; return 0 if it's still running */
+static int finish_background_save( int wait )
+{
+    unsigned char saved = 0;
+    int i, ret;
+
+    if (save_pipe == -1) return 1;
+    if (!wait)
+    {
+        struct pollfd pfd;
+
+        pfd.fd = save_pipe;
+        pfd.events = POLLIN;
+        if (!poll( &pfd, 1, 0 )) return 0;
+    }
+    while ((ret = read( save_pipe, &saved, 1 )) == -1 && errno == EINTR);
+    if (ret != 1) saved = 0;
+    close( save_pipe );
+    save_pipe = -1;
+
+    /* branches that failed to save need to be saved again */
+    for (i = 0; i < save_branch_count; i++)
+    {
+        if (!(save_pending & (1 << i)) || (saved & (1 << i))) continue;
+        if (debug_level) fprintf( stderr, "wineserver: background save of %s failed\n", save_branch_info[i].path );
+        make_dirty( save_branch_info[i].key );
+    }
+    save_pending = 0;
+    return 1;
+}
+
+/* close all the fds the save child inherited from the server, except stdio and the one to keep */
+static void close_save_child_fds( int keep )
+{
+    DIR *dir;
+    struct dirent *de;
+    long fd, max_fd;
+
+    if ((dir = opendir( "/proc/self/fd" )))
+    {
+        while ((de = readdir( dir )))
+        {
+            fd = atol( de->d_name );
+            if (fd > 2 && fd != keep && fd != dirfd( dir )) close( fd );
+        }
+        closedir( dir );
+        return;
+    }
+    max_fd = sysconf( _SC_OPEN_MAX );
+    if (max_fd < 0 || max_fd > 65536) max_fd = 65536;
+    for (fd = 3; fd < max_fd; fd++) if (fd != keep) close( fd );
+}
+
+/* save the dirty branches from a forked child, so that clients don't wait for the disk */
+static int background_save(void)
+{
+    unsigned char saved = 0;
+    unsigned int pending = 0;
+    int i, fds[2];
+    pid_t pid;
+
+    for (i = 0; i < save_branch_count; i++)
+        if (save_branch_info[i].key->flags & KEY_DIRTY) pending |= 1 << i;
+    if (!pending) return 1;
+
+    if (pipe( fds ) == -1) return 0;
+    switch ((pid = fork()))
+    {
+    case -1:
+        close( fds[0] );
+        close( fds[1] );
+        return 0;
+
+    case 0:  /* child, works on a copy-on-write snapshot of the registry */
+        /* The child inherits every server fd, including the client request and
+         * reply pipes; holding them open would keep the server from seeing a
+         * client go away while the save runs. Only the result pipe is kept, the
+         * branch files are opened by name relative to the config dir, which is
+         * the current directory. */
+        close_save_child_fds( fds[1] );
+        for (i = 0; i < save_branch_count; i++)
+            if ((pending & (1 << i)) && save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+                saved |= 1 << i;
+        write( fds[1], &saved, 1 );
+        _exit( 0 );
+
+    default:
+        /* the child is reaped by the SIGCHLD handler */
+        close( fds[1] );
+        fcntl( fds[0], F_SETFD, FD_CLOEXEC );
+        save_pipe = fds[0];
+        save_pending = pending;
+        for (i = 0; i < save_branch_count; i++)
+            if (pending & (1 << i)) make_clean( save_branch_info[i].key );
+        return 1;
+    }
+}
+
+#else  /* USE_PTRACE */
+
+static int finish_background_save( int wait )
+{
+    return 1;
+}
+
+static int background_save(void)
+{
+    return 0;
+}
+
+#endif  /* USE_PTRACE */
+
 /* periodic saving of the registry */
 static void periodic_save( void *arg )
 {
+    unsigned int start = get_tick_count();
     int i;
 
-    if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
-    for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+    if (!finish_background_save( 0 ))
+    {
+        set_periodic_save_timer();  /* still busy, try again later */
+        return;
+    }
+    if (fchdir( config_dir_fd ) == -1) return;
+    if (!background_save())
+    {
+        for (i = 0; i < save_branch_count; i++)
+            save_branch( save_branch_info[i].key, save_branch_info[i].path );
+    }
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
+    if (debug_level) fprintf( stderr, "wineserver: registry save stalled for %u ms\n", get_tick_count() - start );
     set_periodic_save_timer();
 }
 
@@ -2016,6 +2257,7 @@ void flush_registry(void)
 {
     int i;
 
+    finish_background_save( 1 );
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
@@ -70,6 +70,28 @@
 #define WANT_REQUEST_HANDLERS
 #include "request.h"
 
+#define PROFILE_BUCKETS 32
+
+/* per-request statistics collected when profiling is enabled */
+struct request_profile
+{
+    unsigned int       count;        /* number of calls */
+    unsigned long long max_time;     /* longest call in nanoseconds */
+    unsigned long long total_time;   /* total time in nanoseconds */
+    unsigned long long request_size; /* total size of the request data */
+    unsigned long long reply_size;   /* total size of the reply data */
+    unsigned int       histogram[PROFILE_BUCKETS];  /* calls by log2 of the time in nanoseconds */
+};
+
+/* per-process statistics for a request code */
+struct process_request_profile
+{
+    unsigned int       count;        /* number of calls */
+    unsigned long long time;         /* total time in nanoseconds */
+};
+
+static struct request_profile *req_profile;
+
 /* Some versions of glibc don't define this */
 #ifndef SCM_RIGHTS
 #define SCM_RIGHTS 1
@@ -287,6 +309,88 @@ static void send_reply( union generic_reply *reply )
         fatal_protocol_error( current, "reply write: %s\n", strerror( errno ));
 }
 
+/* get the current time in nanoseconds for request profiling */
+static inline unsigned long long get_profile_time(void)
+{
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec ts;
+
+    if (!clock_gettime( CLOCK_MONOTONIC, &ts ))
+        return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+    {
+        struct timeval now;
+        gettimeofday( &now, NULL );
+        return (unsigned long long)now.tv_sec * 1000000000 + now.tv_usec * 1000;
+    }
+}
+
+/* account a request call in the profiling data */
+static void update_request_profile( struct process *process, enum request req, unsigned long long time,
+                                    data_size_t request_size, data_size_t reply_size )
+{
+    struct request_profile *profile = &req_profile[req];
+    unsigned int bucket = 0;
+
+    while (bucket < PROFILE_BUCKETS - 1 && (time >> bucket) > 1) bucket++;
+    profile->count++;
+    profile->total_time += time;
+    if (time > profile->max_time) profile->max_time = time;
+    profile->request_size += request_size;
+    profile->reply_size += reply_size;
+    profile->histogram[bucket]++;
+
+    if (!process->req_profile &&
+        !(process->req_profile = calloc( REQ_NB_REQUESTS, sizeof(*process->req_profile) )))
+        return;
+    process->req_profile[req].count++;
+    process->req_profile[req].time += time;
+}
+
+/* enable the collection of request statistics */
+void init_request_profile(void)
+{
+    if (!(req_profile = calloc( REQ_NB_REQUESTS, sizeof(*req_profile) )))
+        fatal_error( "out of memory\n" );
+    atexit( dump_request_profile );
+}
+
+/* dump the request statistics collected so far */
+void dump_request_profile(void)
+{
+    unsigned int i, j;
+
+    if (!req_profile) return;
+
+    fprintf( stderr, "# request count total_ns max_ns request_bytes reply_bytes histogram(log2 ns)\n" );
+    for (i = 0; i < REQ_NB_REQUESTS; i++)
+    {
+        const struct request_profile *profile = &req_profile[i];
+
+        if (!profile->count) continue;
+        fprintf( stderr, "%s %u %llu %llu %llu %llu", get_req_name( i ), profile->count,
+                 profile->total_time, profile->max_time, profile->request_size, profile->reply_size );
+        for (j = 0; j < PROFILE_BUCKETS; j++) fprintf( stderr, " %u", profile->histogram[j] );
+        fputc( '\n', stderr );
+    }
+}
+
+/* dump the request statistics of a process that is going away */
+void dump_process_request_profile( struct process *process )
+{
+    unsigned int i;
+
+    if (!process->req_profile) return;
+
+    for (i = 0; i < REQ_NB_REQUESTS; i++)
+    {
+        if (!process->req_profile[i].count) continue;
+        fprintf( stderr, "wineserver: process %04x (unix pid %d): %s %u %llu ns\n",
+                 process->id, process->unix_pid, get_req_name( i ),
+                 process->req_profile[i].count, process->req_profile[i].time );
+    }
+}
+
 /* call a request handler */
 static void call_req_handler( struct thread *thread )
 {
@@ -301,7 +405,20 @@ static void call_req_handler( struct thread *thread )
     if (debug_level) trace_request();
 
     if (req < REQ_NB_REQUESTS)
-        req_handlers[req]( &current->req, &reply );
+    {
+        if (req_profile)
+        {
+            struct process *process = (struct process *)grab_object( thread->process );
+            data_size_t request_size = get_req_data_size();
+            unsigned long long start = get_profile_time();
+
+            req_handlers[req]( &current->req, &reply );
+            update_request_profile( process, req, get_profile_time() - start,
+                                    request_size, current ? current->reply_size : 0 );
+            release_object( process );
+        }
+        else req_handlers[req]( &current->req, &reply );
+    }
     else
         set_error( STATUS_NOT_IMPLEMENTED );
 
@@ -326,12 +443,28 @@ static void call_req_handler( struct thread *thread )
 /* read a request from a thread */
 void read_request( struct thread *thread )
 {
+    static char prefetch[8192];  /* variable data read along with the request header */
     int ret;
 
     if (!thread->req_toread)  /* no pending request */
     {
-        if ((ret = read( get_unix_fd( thread->request_fd ), &thread->req,
-                         sizeof(thread->req) )) != sizeof(thread->req)) goto error;
+        struct iovec vec[2];
+
+        /* the client doesn't send anything else until it gets the reply, so we can
+         * try to get the header and the data in a single system call */
+        vec[0].iov_base = &thread->req;
+        vec[0].iov_len  = sizeof(thread->req);
+        vec[1].iov_base = prefetch;
+        vec[1].iov_len  = sizeof(prefetch);
+
+        if ((ret = readv( get_unix_fd( thread->request_fd ), vec, 2 )) < (int)sizeof(thread->req))
+            goto error;
+        ret -= sizeof(thread->req);
+        if (ret > thread->req.request_header.request_size)
+        {
+            fatal_protocol_error( thread, "extra data %d\n", ret );
+            return;
+        }
         if (!(thread->req_toread = thread->req.request_header.request_size))
         {
             /* no data, handle request at once */
@@ -344,6 +477,14 @@ void read_request( struct thread *thread )
                                   thread->req_toread, thread->req.request_header.req );
             return;
         }
+        memcpy( thread->req_data, prefetch, ret );
+        if (!(thread->req_toread -= ret))
+        {
+            call_req_handler( thread );
+            free( thread->req_data );
+            thread->req_data = NULL;
+            return;
+        }
     }
 
     /* read the variable sized data */
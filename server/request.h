@@ -62,8 +62,13 @@ extern int wait_for_lock(void);
 extern int kill_lock_owner( int sig );
 extern int server_dir_fd, config_dir_fd;
 
+extern void init_request_profile(void);
+extern void dump_request_profile(void);
+extern void dump_process_request_profile( struct process *process );
+
 extern void trace_request(void);
 extern void trace_reply( enum request req, const union generic_reply *reply );
+extern const char *get_req_name( enum request req );
 
 /* get the request vararg data */
 static inline const void *get_req_data(void)
@@ -171,6 +176,7 @@ DECL_HANDLER(set_socket_event);
 DECL_HANDLER(get_socket_event);
 DECL_HANDLER(get_socket_info);
 DECL_HANDLER(enable_socket_event);
+DECL_HANDLER(complete_socket_io);
 DECL_HANDLER(set_socket_deferred);
 DECL_HANDLER(alloc_console);
 DECL_HANDLER(free_console);
@@ -383,6 +389,7 @@ DECL_HANDLER(add_completion);
 DECL_HANDLER(remove_completion);
 DECL_HANDLER(query_completion);
 DECL_HANDLER(set_completion_info);
+DECL_HANDLER(set_fd_completion_mode);
 DECL_HANDLER(add_fd_completion);
 DECL_HANDLER(set_fd_disp_info);
 DECL_HANDLER(set_fd_name_info);
@@ -470,6 +477,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_socket_event,
     (req_handler)req_get_socket_info,
     (req_handler)req_enable_socket_event,
+    (req_handler)req_complete_socket_io,
     (req_handler)req_set_socket_deferred,
     (req_handler)req_alloc_console,
     (req_handler)req_free_console,
@@ -682,6 +690,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_remove_completion,
     (req_handler)req_query_completion,
     (req_handler)req_set_completion_info,
+    (req_handler)req_set_fd_completion_mode,
     (req_handler)req_add_fd_completion,
     (req_handler)req_set_fd_disp_info,
     (req_handler)req_set_fd_name_info,
@@ -1106,6 +1115,13 @@ C_ASSERT( FIELD_OFFSET(struct enable_socket_event_request, mask) == 16 );
 C_ASSERT( FIELD_OFFSET(struct enable_socket_event_request, sstate) == 20 );
 C_ASSERT( FIELD_OFFSET(struct enable_socket_event_request, cstate) == 24 );
 C_ASSERT( sizeof(struct enable_socket_event_request) == 32 );
+C_ASSERT( FIELD_OFFSET(struct complete_socket_io_request, handle) == 12 );
+C_ASSERT( FIELD_OFFSET(struct complete_socket_io_request, event) == 16 );
+C_ASSERT( FIELD_OFFSET(struct complete_socket_io_request, cvalue) == 24 );
+C_ASSERT( FIELD_OFFSET(struct complete_socket_io_request, information) == 32 );
+C_ASSERT( FIELD_OFFSET(struct complete_socket_io_request, status) == 40 );
+C_ASSERT( FIELD_OFFSET(struct complete_socket_io_request, mask) == 44 );
+C_ASSERT( sizeof(struct complete_socket_io_request) == 48 );
 C_ASSERT( FIELD_OFFSET(struct set_socket_deferred_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_socket_deferred_request, deferred) == 16 );
 C_ASSERT( sizeof(struct set_socket_deferred_request) == 24 );
@@ -2323,6 +2339,9 @@ C_ASSERT( FIELD_OFFSET(struct set_completion_info_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_completion_info_request, ckey) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_completion_info_request, chandle) == 24 );
 C_ASSERT( sizeof(struct set_completion_info_request) == 32 );
+C_ASSERT( FIELD_OFFSET(struct set_fd_completion_mode_request, handle) == 12 );
+C_ASSERT( FIELD_OFFSET(struct set_fd_completion_mode_request, flags) == 16 );
+C_ASSERT( sizeof(struct set_fd_completion_mode_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, cvalue) == 16 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, information) == 24 );
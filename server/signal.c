@@ -100,6 +100,7 @@ static struct handler *handler_sigterm;
 static struct handler *handler_sigint;
 static struct handler *handler_sigchld;
 static struct handler *handler_sigio;
+static struct handler *handler_sigusr1;
 
 static int watchdog;
 
@@ -189,6 +190,12 @@ static void sigterm_callback(void)
     exit(1);
 }
 
+/* SIGUSR1 callback */
+static void sigusr1_callback(void)
+{
+    dump_request_profile();
+}
+
 /* SIGINT callback */
 static void sigint_callback(void)
 {
@@ -213,6 +220,12 @@ static void do_sigint( int signum )
     do_signal( handler_sigint );
 }
 
+/* SIGUSR1 handler */
+static void do_sigusr1( int signum )
+{
+    do_signal( handler_sigusr1 );
+}
+
 /* SIGALRM handler */
 static void do_sigalrm( int signum )
 {
@@ -279,6 +292,7 @@ void init_signals(void)
     if (!(handler_sigint  = create_handler( sigint_callback ))) goto error;
     if (!(handler_sigchld = create_handler( sigchld_callback ))) goto error;
     if (!(handler_sigio   = create_handler( sigio_callback ))) goto error;
+    if (!(handler_sigusr1 = create_handler( sigusr1_callback ))) goto error;
 
     sigemptyset( &blocked_sigset );
     sigaddset( &blocked_sigset, SIGCHLD );
@@ -288,6 +302,7 @@ void init_signals(void)
     sigaddset( &blocked_sigset, SIGIO );
     sigaddset( &blocked_sigset, SIGQUIT );
     sigaddset( &blocked_sigset, SIGTERM );
+    sigaddset( &blocked_sigset, SIGUSR1 );
 #ifdef SIG_PTHREAD_CANCEL
     sigaddset( &blocked_sigset, SIG_PTHREAD_CANCEL );
 #endif
@@ -303,6 +318,8 @@ void init_signals(void)
     sigaction( SIGHUP, &action, NULL );
     action.sa_handler = do_sigint;
     sigaction( SIGINT, &action, NULL );
+    action.sa_handler = do_sigusr1;
+    sigaction( SIGUSR1, &action, NULL );
     action.sa_handler = do_sigalrm;
     sigaction( SIGALRM, &action, NULL );
     action.sa_handler = do_sigterm;
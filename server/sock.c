@@ -561,6 +561,17 @@ static int sock_ioctl( struct fd *fd, ioctl_code_t code, struct async *async )
     }
 }
 
+/* a completed read re-enables FD_READ, as the client would after a recv() */
+static void sock_read_complete( struct fd *fd, unsigned int status )
+{
+    struct sock *sock = get_fd_user( fd );
+
+    if (status != STATUS_SUCCESS) return;
+    sock->pmask &= ~FD_READ;
+    sock->hmask &= ~FD_READ;
+    sock_reselect( sock );
+}
+
 static void sock_queue_async( struct fd *fd, struct async *async, int type, int count )
 {
     struct sock *sock = get_fd_user( fd );
@@ -571,6 +582,7 @@ static void sock_queue_async( struct fd *fd, struct async *async, int type, int
     switch (type)
     {
     case ASYNC_TYPE_READ:
+    case ASYNC_TYPE_RECV:
         queue = &sock->read_q;
         break;
     case ASYNC_TYPE_WRITE:
@@ -581,14 +593,16 @@ static void sock_queue_async( struct fd *fd, struct async *async, int type, int
         return;
     }
 
-    if ( ( !( sock->state & (FD_READ|FD_CONNECT|FD_WINE_LISTENING) ) && type == ASYNC_TYPE_READ  ) ||
-         ( !( sock->state & (FD_WRITE|FD_CONNECT) ) && type == ASYNC_TYPE_WRITE ) )
+    if ( ( !( sock->state & (FD_READ|FD_CONNECT|FD_WINE_LISTENING) ) && queue == &sock->read_q ) ||
+         ( !( sock->state & (FD_WRITE|FD_CONNECT) ) && queue == &sock->write_q ) )
     {
         set_error( STATUS_PIPE_DISCONNECTED );
         return;
     }
 
     queue_async( queue, async );
+    /* only actual receives re-enable FD_READ, not accept or shutdown asyncs */
+    if (type == ASYNC_TYPE_RECV) async_set_completion_callback( async, sock_read_complete );
     sock_reselect( sock );
 
     set_error( STATUS_PENDING );
@@ -1326,6 +1340,36 @@ DECL_HANDLER(enable_socket_event)
     release_object( &sock->obj );
 }
 
+/* report a socket I/O operation that completed without blocking */
+DECL_HANDLER(complete_socket_io)
+{
+    struct sock *sock;
+    struct event *event;
+
+    /* queuing the completion doesn't need any access, like add_fd_completion */
+    if (req->cvalue && (sock = (struct sock*)get_handle_obj( current->process, req->handle, 0, &sock_ops )))
+    {
+        fd_add_completion( sock->fd, req->cvalue, req->status, req->information );
+        release_object( &sock->obj );
+    }
+
+    /* re-enabling events needs the same access as enable_socket_event */
+    if (req->mask && (sock = (struct sock*)get_handle_obj( current->process, req->handle,
+                                                           FILE_WRITE_ATTRIBUTES, &sock_ops )))
+    {
+        sock->pmask &= ~req->mask;
+        sock->hmask &= ~req->mask;
+        sock_reselect( sock );
+        release_object( &sock->obj );
+    }
+
+    if (req->event && (event = get_event_obj( current->process, req->event, EVENT_MODIFY_STATE )))
+    {
+        set_event( event );
+        release_object( event );
+    }
+}
+
 DECL_HANDLER(set_socket_deferred)
 {
     struct sock *sock, *acceptsock;
@@ -1942,6 +1942,16 @@ static void dump_enable_socket_event_request( const struct enable_socket_event_r
     fprintf( stderr, ", cstate=%08x", req->cstate );
 }
 
+static void dump_complete_socket_io_request( const struct complete_socket_io_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", event=%04x", req->event );
+    dump_uint64( ", cvalue=", &req->cvalue );
+    dump_uint64( ", information=", &req->information );
+    fprintf( stderr, ", status=%08x", req->status );
+    fprintf( stderr, ", mask=%08x", req->mask );
+}
+
 static void dump_set_socket_deferred_request( const struct set_socket_deferred_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4367,6 +4377,12 @@ static void dump_set_completion_info_request( const struct set_completion_info_r
     fprintf( stderr, ", chandle=%04x", req->chandle );
 }
 
+static void dump_set_fd_completion_mode_request( const struct set_fd_completion_mode_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", flags=%08x", req->flags );
+}
+
 static void dump_add_fd_completion_request( const struct add_fd_completion_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4627,6 +4643,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_socket_event_request,
     (dump_func)dump_get_socket_info_request,
     (dump_func)dump_enable_socket_event_request,
+    (dump_func)dump_complete_socket_io_request,
     (dump_func)dump_set_socket_deferred_request,
     (dump_func)dump_alloc_console_request,
     (dump_func)dump_free_console_request,
@@ -4839,6 +4856,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_remove_completion_request,
     (dump_func)dump_query_completion_request,
     (dump_func)dump_set_completion_info_request,
+    (dump_func)dump_set_fd_completion_mode_request,
     (dump_func)dump_add_fd_completion_request,
     (dump_func)dump_set_fd_disp_info_request,
     (dump_func)dump_set_fd_name_info_request,
@@ -4924,6 +4942,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_socket_info_reply,
     NULL,
     NULL,
+    NULL,
     (dump_func)dump_alloc_console_reply,
     NULL,
     (dump_func)dump_get_console_renderer_events_reply,
@@ -5138,6 +5157,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     NULL,
     NULL,
+    NULL,
     (dump_func)dump_get_window_layered_info_reply,
     NULL,
     (dump_func)dump_alloc_user_handle_reply,
@@ -5219,6 +5239,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_socket_event",
     "get_socket_info",
     "enable_socket_event",
+    "complete_socket_io",
     "set_socket_deferred",
     "alloc_console",
     "free_console",
@@ -5431,6 +5452,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "remove_completion",
     "query_completion",
     "set_completion_info",
+    "set_fd_completion_mode",
     "add_fd_completion",
     "set_fd_disp_info",
     "set_fd_name_info",
@@ -5520,6 +5542,7 @@ static const struct
     { "INVALID_LOCK_SEQUENCE",       STATUS_INVALID_LOCK_SEQUENCE },
     { "INVALID_OWNER",               STATUS_INVALID_OWNER },
     { "INVALID_PARAMETER",           STATUS_INVALID_PARAMETER },
+    { "INVALID_PARAMETER_4",         STATUS_INVALID_PARAMETER_4 },
     { "INVALID_READ_MODE",           STATUS_INVALID_READ_MODE },
     { "INVALID_SECURITY_DESCR",      STATUS_INVALID_SECURITY_DESCR },
     { "IO_TIMEOUT",                  STATUS_IO_TIMEOUT },
@@ -5634,3 +5657,9 @@ void trace_reply( enum request req, const union generic_reply *reply )
     else fprintf( stderr, "%04x: %d() = %s\n",
                   current->id, req, get_status_name(current->error) );
 }
+
+const char *get_req_name( enum request req )
+{
+    if (req < REQ_NB_REQUESTS) return req_names[req];
+    return "?";
+}